@@ -0,0 +1,115 @@
+#ifndef MY_CATALOG
+#define MY_CATALOG
+
+#include "../Rtree/RTree.h"
+
+/*
+top level index of a forest: a small R-Tree over the root MBR of every
+non-empty tree, with the number of rectangles each tree holds, so the trees
+a query can reach are found in O(log T) instead of touching all of them.
+it is built once when a forest is registered and kept up to date by
+update() after every insertion. a root that grows gets a new entry in the
+index, and the old one is left behind as stale and skipped by the queries.
+the index is packed again once stale entries outnumber the live ones
+*/
+class ForestCatalog {
+public:
+    ForestCatalog();
+    ForestCatalog(std::vector<Rectangle> _roots, std::vector<long> _counts);
+    void update(int tree, const Rectangle& rect);
+    template <typename Visitor>
+    void overlapping(const Rectangle& rect, Visitor&& visit) const;
+    std::vector<int> overlapping(const Rectangle& rect) const;
+    Rectangle getBound() const;
+    long count(int tree) const;
+    int size() const;
+
+private:
+    Rtree index; // root MBRs, the id of an entry is its position in owner
+    std::vector<Rectangle> roots; // root MBR of every tree
+    std::vector<long> counts; // rectangles in every tree
+    std::vector<int> entryOf; // live entry of every tree, -1 for an empty tree
+    std::vector<int> owner; // tree of every entry in index
+    size_t stale; // entries of index replaced by a larger MBR
+    Rectangle bound; // union of the roots of the non-empty trees
+    void rebuild();
+};
+
+ForestCatalog :: ForestCatalog() : stale(0), bound(Point(1, 1), Point(0, 0)) {
+    rebuild();
+}
+
+// roots[j] and counts[j] are the root MBR and the number of rectangles of tree j
+ForestCatalog :: ForestCatalog(std::vector<Rectangle> _roots, std::vector<long> _counts) :
+                               roots(std::move(_roots)), counts(std::move(_counts)), entryOf(roots.size(), -1),
+                               stale(0), bound(Point(1, 1), Point(0, 0)) {
+    rebuild();
+}
+
+// pack the live roots into a new index
+void ForestCatalog :: rebuild() {
+    std::vector<Rectangle> rects;
+    owner.clear();
+    bound = Rectangle(Point(1, 1), Point(0, 0));
+    for(size_t j = 0; j < roots.size(); j++) {
+        entryOf[j] = -1;
+        if(counts[j] == 0) continue;
+        entryOf[j] = owner.size();
+        owner.push_back(j);
+        rects.push_back(roots[j]);
+        bound = rects.size() == 1 ? roots[j] : bound.unionRect(roots[j]);
+    }
+    index = Rtree();
+    index.initite(-1, 0, 0, MAX_NODE_SPACE, 0);
+    if(!rects.empty()) index.bulkLoad(rects);
+    stale = 0;
+}
+
+// rect was inserted into tree, grow its root when rect is outside of it
+void ForestCatalog :: update(int tree, const Rectangle& rect) {
+    counts[tree] += 1;
+    if(counts[tree] > 1 && roots[tree].cover(rect)) return;
+    roots[tree] = counts[tree] > 1 ? roots[tree].unionRect(rect) : rect;
+    bound = owner.size() > stale ? bound.unionRect(rect) : rect;
+    if(entryOf[tree] != -1) stale += 1;
+    entryOf[tree] = owner.size();
+    owner.push_back(tree);
+    index.insertNode(roots[tree], entryOf[tree]);
+    if(stale > owner.size() - stale) rebuild();
+}
+
+// visit(int tree) for every non-empty tree whose root MBR intersects rect
+template <typename Visitor>
+void ForestCatalog :: overlapping(const Rectangle& rect, Visitor&& visit) const {
+    if(rect.low.x > rect.high.x || rect.low.y > rect.high.y) return;
+    index.queryEntries(rect, [this, &visit](const Rectangle&, int entry) {
+        int tree = owner[entry];
+        if(entryOf[tree] == entry) visit(tree);
+    });
+}
+
+// the trees whose root MBR intersects rect, in increasing order
+std::vector<int> ForestCatalog :: overlapping(const Rectangle& rect) const {
+    std::vector<int> trees;
+    overlapping(rect, [&trees](int tree) {
+        trees.push_back(tree);
+    });
+    std::sort(trees.begin(), trees.end());
+    return trees;
+}
+
+// union of the root MBRs, an empty rectangle when every tree is empty
+Rectangle ForestCatalog :: getBound() const {
+    return bound;
+}
+
+long ForestCatalog :: count(int tree) const {
+    return counts[tree];
+}
+
+// number of trees, empty ones included
+int ForestCatalog :: size() const {
+    return roots.size();
+}
+
+#endif
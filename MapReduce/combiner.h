@@ -0,0 +1,80 @@
+#ifndef MY_COMBINER
+#define MY_COMBINER
+
+#include "../Rtree/config.h"
+
+// partial aggregate of the values of one key, only the fields of the combiner's mode are used
+struct Summary {
+    long count; // number of values
+    double area; // sum of their areas
+    Rectangle bound; // union of their MBRs
+    std::vector<Rectangle> top; // the k largest values by area, largest first
+
+    Summary() : count(0), area(0.0) {}
+};
+
+/*
+map side aggregation. a combiner folds the values a mapper produced for a
+key into one Summary before the shuffle, and the reducer merges the
+summaries of the same key from all mappers, so only partial aggregates
+cross the shuffle. mode: 0 - count, 1 - sum of areas, 2 - bounding box
+union, 3 - top k by area
+*/
+class Combiner {
+public:
+    int mode;
+    int k; // number of values kept by top k
+
+    Combiner(int _mode = 0, int _k = 1);
+    Summary combine(const std::vector<Rectangle>& values) const;
+    void merge(Summary& into, const Summary& from) const;
+
+private:
+    void keepTop(std::vector<Rectangle>& values) const;
+};
+
+Combiner :: Combiner(int _mode, int _k) : mode(_mode), k(std::max(1, _k)) {}
+
+// fold the values of one key into a summary
+Summary Combiner :: combine(const std::vector<Rectangle>& values) const {
+    Summary summary;
+    summary.count = values.size();
+    if(values.empty()) return summary;
+    if(mode == 1) {
+        for(const Rectangle& value : values) {
+            summary.area += value.getArea();
+        }
+    } else if(mode == 2) {
+        summary.bound = Rectangle::unionRects(values);
+    } else if(mode == 3) {
+        summary.top = values;
+        keepTop(summary.top);
+    }
+    return summary;
+}
+
+// add the summary of another part of the same key
+void Combiner :: merge(Summary& into, const Summary& from) const {
+    if(from.count == 0) return;
+    if(mode == 1) {
+        into.area += from.area;
+    } else if(mode == 2) {
+        into.bound = into.count == 0 ? from.bound : into.bound.unionRect(from.bound);
+    } else if(mode == 3) {
+        into.top.insert(into.top.end(), from.top.begin(), from.top.end());
+        keepTop(into.top);
+    }
+    into.count += from.count;
+}
+
+// keep the k largest rectangles by area, largest first
+void Combiner :: keepTop(std::vector<Rectangle>& values) const {
+    auto larger = [](const Rectangle& a, const Rectangle& b) { return a.getArea() > b.getArea(); };
+    if(values.size() > static_cast<size_t>(k)) {
+        std::nth_element(values.begin(), values.begin() + (k - 1), values.end(), larger);
+        values.resize(k);
+    }
+    std::sort(values.begin(), values.end(), larger);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef MY_FOREST
+#define MY_FOREST
+
+#include "catalog.h"
+#include <memory>
+
+// a tree shared by every forest and job reading it, never copied by them
+typedef std::shared_ptr<const Rtree> TreeHandle;
+
+/*
+a registered dataset: the trees of a query and their catalog. jobs and
+sub-jobs hold the forest through a ForestHandle, so dispatching a query
+only counts references and never copies an index. trees are never changed
+in place, insert() builds a new tree from a copy and replaces the handle
+*/
+class Forest {
+public:
+    Forest();
+    explicit Forest(std::vector<Rtree>&& _trees);
+    const Rtree& operator [] (int index) const;
+    TreeHandle getTree(int index) const;
+    int size() const;
+    const ForestCatalog& getCatalog() const;
+    void insert(int tree, Rectangle rect);
+    void insert(int tree, const std::vector<Rectangle>& rects);
+
+private:
+    std::vector<TreeHandle> trees;
+    ForestCatalog catalog; // root MBRs of trees
+    void buildCatalog();
+};
+
+typedef std::shared_ptr<const Forest> ForestHandle;
+
+Forest :: Forest() {}
+
+// the trees are moved into shared handles
+Forest :: Forest(std::vector<Rtree>&& _trees) {
+    for(Rtree& tree : _trees) {
+        trees.push_back(std::make_shared<Rtree>(std::move(tree)));
+    }
+    buildCatalog();
+}
+
+// the one pass over the trees, done when the forest is registered
+void Forest :: buildCatalog() {
+    std::vector<Rectangle> roots;
+    std::vector<long> counts;
+    for(const TreeHandle& tree : trees) {
+        long rectNums = 0;
+        tree -> query(tree -> getFinalRect(), [&rectNums](const Rectangle&) {
+            rectNums += 1;
+        });
+        roots.push_back(tree -> getFinalRect());
+        counts.push_back(rectNums);
+    }
+    catalog = ForestCatalog(std::move(roots), std::move(counts));
+}
+
+const Rtree& Forest :: operator [] (int index) const {
+    return *trees[index];
+}
+
+TreeHandle Forest :: getTree(int index) const {
+    return trees[index];
+}
+
+int Forest :: size() const {
+    return trees.size();
+}
+
+const ForestCatalog& Forest :: getCatalog() const {
+    return catalog;
+}
+
+// insert rect into one tree and keep the catalog up to date
+void Forest :: insert(int tree, Rectangle rect) {
+    insert(tree, std::vector<Rectangle>(1, rect));
+}
+
+/*
+insert rects into one tree and keep the catalog up to date. the tree is
+copied, the copy takes the rectangles and replaces the handle, so holders
+of the old handle keep reading the old tree. the copy is paid once per call
+*/
+void Forest :: insert(int tree, const std::vector<Rectangle>& rects) {
+    std::shared_ptr<Rtree> copy = std::make_shared<Rtree>(*trees[tree]);
+    for(const Rectangle& rect : rects) {
+        copy -> insertNode(rect, -2);
+        catalog.update(tree, rect);
+    }
+    trees[tree] = std::move(copy);
+}
+
+#endif
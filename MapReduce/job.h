@@ -1,16 +1,43 @@
 #ifndef MY_JOB
 #define MY_JOB
 
-#include "../Rtree/Rtree.h"
+#include "../Rtree/RTree.h"
+#include "forest.h"
 
 class Job {
 public:
     Rectangle query; // query in the job, represented by a rectangle
-    std::vector<Rtree> data; // corresponding data in the job, set of R-Tree
+    ForestHandle data; // corresponding data in the job, set of R-Tree shared with every copy of the job
+    Rectangle bound; // the whole query when query is one piece of it, equal to query otherwise
+    int queryMode; // 0 - rectangles contained in the query, 1 - rectangles intersecting the query
 
-    Job() {};
-    Job(Rectangle _query, std::vector<Rtree> _data) : query(_query), data(_data) {}
+    Job() : data(std::make_shared<Forest>()), queryMode(0) {};
+    Job(Rectangle _query, ForestHandle _data, int _queryMode = 0) : query(_query), data(std::move(_data)),
+                                                                    bound(_query), queryMode(_queryMode) {}
+    // the trees are moved into a new forest, share a ForestHandle to run several jobs on them
+    Job(Rectangle _query, std::vector<Rtree>&& _data, int _queryMode = 0) : query(_query),
+                                                                         data(std::make_shared<Forest>(std::move(_data))),
+                                                                         bound(_query), queryMode(_queryMode) {}
+    void insert(int tree, Rectangle rect);
+    void insert(int tree, const std::vector<Rectangle>& rects);
 };
 
+// insert rect into one tree of the data
+void Job :: insert(int tree, Rectangle rect) {
+    insert(tree, std::vector<Rectangle>(1, rect));
+}
+
+/*
+insert rects into one tree of the data. the forest is never changed in
+place: it is copied, which copies the handles of its trees and the one tree
+taking the rectangles, and the job moves to the copy. jobs still holding the
+old forest are not affected. insert a batch at once to copy once
+*/
+void Job :: insert(int tree, const std::vector<Rectangle>& rects) {
+    std::shared_ptr<Forest> copy = std::make_shared<Forest>(*data);
+    copy -> insert(tree, rects);
+    data = std::move(copy);
+}
+
 
 #endif
\ No newline at end of file
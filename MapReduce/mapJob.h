@@ -0,0 +1,32 @@
+#ifndef MY_MAP_JOB
+#define MY_MAP_JOB
+
+#include <functional>
+#include <vector>
+
+/*
+generic MapReduce job. every input is one map task: map(input, emit) calls
+emit(key, value) for each pair it produces. the values of a key are moved
+into reduce(key, values), which folds them into the key's final value. map
+and reduce are template parameters, so the calls inline into the loops of
+Master::execute. Hash spreads the keys over the reducers
+*/
+template <typename Input, typename Key, typename Value, typename Map, typename Reduce, typename Hash = std::hash<Key>>
+class MapJob {
+public:
+    std::vector<Input> inputs; // one map task per input
+    Map map;
+    Reduce reduce;
+    bool combine; // reduce is associative, so it also folds the output of every map task before the shuffle
+
+    MapJob(std::vector<Input> _inputs, Map _map, Reduce _reduce, bool _combine = false) :
+           inputs(std::move(_inputs)), map(_map), reduce(_reduce), combine(_combine) {}
+};
+
+// build a job with key and value given and the rest deduced, e.g. makeMapJob<int, double>(inputs, map, reduce)
+template <typename Key, typename Value, typename Input, typename Map, typename Reduce>
+MapJob<Input, Key, Value, Map, Reduce> makeMapJob(std::vector<Input> inputs, Map map, Reduce reduce, bool combine = false) {
+    return MapJob<Input, Key, Value, Map, Reduce>(std::move(inputs), map, reduce, combine);
+}
+
+#endif
@@ -2,64 +2,584 @@
 #define MY_MASTER
 
 #include "worker.h"
+#include "threadPool.h"
+#include "mapJob.h"
+#include "streamQueue.h"
+#include <string>
+#include <cstdlib>
+
+const int PARTITION_SAMPLES = 128; // sampled leaves per worker when splitJob estimates the work of a query
+const int TREE_SAMPLES = 16; // sampled leaves per tree when the forest is split among the workers
+const int STREAM_BATCH = 128; // results a mapper gathers before handing them to a reducer in streaming mode
+const int STREAM_QUEUE_SIZE = 64; // batches waiting for one reducer before the mappers are held back
+
+// directory of the spill files when setSpill is not given one, $TMPDIR or else /tmp
+std::string defaultSpillDirectory() {
+    const char* directory = std::getenv("TMPDIR");
+    return directory != nullptr && *directory != '\0' ? directory : "/tmp";
+}
+
+// results of one mapper for one key, the unit passed from mappers to reducers in streaming mode
+struct StreamBatch {
+    int key;
+    std::vector<Rectangle> values;
+};
+
+// reduce step of excutor and aggregate, every value of the reducer's keys is gathered in memory
+void shuffleAndReduce(Worker& reducer, std::vector<Worker>& workers, int reducerId) {
+    reducer.shuffle_and_reduce(workers, reducerId);
+}
 
 class Master {
 public:
-    Job preProcessor(Job job);
-    std::vector<Rectangle> excutor(Job& job, int workerNums);
-    std::vector<Job> splitJob(Job job, int workerNums);
+    Master();
+    explicit Master(int threadNums);
+    Job preProcessor(const Job& job);
+    std::vector<Rectangle> excutor(Job& job, int workerNums, int reducerNums = 0);
+    std::map<int, Summary> aggregate(Job& job, int workerNums, const Combiner& combiner, int reducerNums = 0);
+    template <typename Consumer>
+    void stream(Job& job, int workerNums, Consumer&& consume, int reducerNums = 1);
+    template <typename Consumer>
+    void reduceEach(Job& job, int workerNums, Consumer&& consume, int reducerNums = 0);
+    template <typename Input, typename Key, typename Value, typename Map, typename Reduce, typename Hash>
+    std::map<Key, Value> execute(MapJob<Input, Key, Value, Map, Reduce, Hash>& job, int reducerNums = 0);
+    std::vector<Job> splitJob(const Job& job, int workerNums);
+    Rectangle clipQuery(const Job& job) const;
+    std::vector<Rectangle> splitQuery(const Rectangle& query, const Job& job, int workerNums);
+    std::vector<double> predictedCost; // expected hits of every sub-job, filled by splitJob
+    std::vector<int> actualCost; // hits every worker produced in the last excutor call
+    Partitioner partitioner; // decides the reducer of every key
+    void setSpill(FileManager& _fileManager, size_t _spillBudget, const std::string& _spillDirectory = defaultSpillDirectory());
+    int partitionMode; // 0 - split the query among the workers, 1 - split the forest among the workers
+    std::string printCost() const;
+
+private:
+    struct CostSample {
+        Point center; // reference point of a sampled result, the piece holding it reports the result
+        double weight; // results the sample stands for
+    };
+
+    // one tree searched by one mapper with one piece of the query
+    struct MapUnit {
+        int tree; // index in the job's data, also the key of the hits
+        Rectangle piece;
+    };
+
+    ThreadPool pool; // threads running the mappers
+    FileManager* spillManager; // page layer of the spill files, nullptr - never spill
+    size_t spillBudget; // values a map buffer holds in memory before it is spilled to disk
+    std::string spillDirectory; // where the spill files are created
+    std::vector<std::vector<MapUnit>> planUnits(const Job& job, const Rectangle& bound, int workerNums);
+    std::vector<std::vector<MapUnit>> assignTrees(const Job& job, const Rectangle& bound, int workerNums);
+    void sampleCost(const Rtree& tree, const Rectangle& query, int queryMode, int target,
+                    std::vector<CostSample>& samples) const;
+    template <typename ReduceStep>
+    std::vector<Worker> run(Job& job, int workerNums, int reducerNums, const Combiner* combiner, ReduceStep&& reduceStep);
+    void partition(Rectangle region, int parts, std::vector<CostSample>& samples, int begin, int end,
+                   std::vector<Rectangle>& pieces);
+    template <typename Key, typename Value, typename Reduce>
+    static std::map<Key, Value> reduceGroups(std::vector<std::vector<std::pair<Key, Value>>*>& buffers, Reduce& reduce);
 };
 
-std::vector<Rectangle> Master :: excutor(Job& job, int workerNums) {
+// one thread per hardware thread
+Master :: Master() : partitioner(hashPartitioner), partitionMode(0),
+                     pool(std::max(1u, std::thread::hardware_concurrency())), spillManager(nullptr), spillBudget(0) {}
+
+Master :: Master(int threadNums) : partitioner(hashPartitioner), partitionMode(0),
+                                   pool(threadNums), spillManager(nullptr), spillBudget(0) {}
+
+/*
+spill map output through fileManager once a buffer holds spillBudget values,
+a budget of 0 turns spilling off. the FileManager is owned by the caller and
+must outlive the jobs run with it, it may be shared with a disk R-Tree or
+with other masters. every job spills to a file of its own in spillDirectory,
+named mapreduce.spill.<pid>.<number>, by default in $TMPDIR or /tmp. jobs run
+with a combiner keep the same budget without touching the disk: a buffer
+reaching it is folded into its summary and emptied
+*/
+void Master :: setSpill(FileManager& _fileManager, size_t _spillBudget, const std::string& _spillDirectory) {
+    this -> spillManager = _spillBudget > 0 ? &_fileManager : nullptr;
+    this -> spillBudget = _spillBudget;
+    this -> spillDirectory = _spillDirectory;
+}
+
+/*
+run the job on workerNums mappers and reducerNums reducers, 0 reducers means
+one per mapper. return the values of all keys, in the order of the keys
+*/
+std::vector<Rectangle> Master :: excutor(Job& job, int workerNums, int reducerNums) {
+    std::vector<Worker> reducers = run(job, workerNums, reducerNums, nullptr, shuffleAndReduce);
+    // every key was reduced by exactly one reducer
+    std::vector<std::pair<int, std::vector<Rectangle>*>> keys;
+    for(Worker& reducer : reducers) {
+        for(std::pair<const int, std::vector<Rectangle>>& entry : reducer.reducing_result) {
+            keys.push_back(std::make_pair(entry.first, &entry.second));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<Rectangle> result;
+    for(std::pair<int, std::vector<Rectangle>*>& key : keys) {
+        if(result.empty()) result = std::move(*key.second);
+        else result.insert(result.end(), key.second -> begin(), key.second -> end());
+    }
+    return result;
+}
+
+/*
+run the job with the combiner folding every mapper's output before the
+shuffle, return the summary of every key
+*/
+std::map<int, Summary> Master :: aggregate(Job& job, int workerNums, const Combiner& combiner, int reducerNums) {
+    std::vector<Worker> reducers = run(job, workerNums, reducerNums, &combiner, shuffleAndReduce);
+    std::map<int, Summary> result;
+    for(Worker& reducer : reducers) {
+        for(std::pair<const int, Summary>& entry : reducer.reducing_summary) {
+            result.emplace(entry.first, std::move(entry.second));
+        }
+    }
+    return result;
+}
+
+/*
+excutor without gathering the answer: every reducer hands the values of its
+keys to consume(key, values) while it merges them, in order of key, see
+Worker::reduce. values read back from the spill file come at most the spill
+budget at a time, so with setSpill the memory of the reduce side stays
+bounded as well as that of the map side. consume may take the values and
+must be thread safe when there is more than one reducer
+*/
+template <typename Consumer>
+void Master :: reduceEach(Job& job, int workerNums, Consumer&& consume, int reducerNums) {
+    size_t batch = spillBudget;
+    run(job, workerNums, reducerNums, nullptr, [&consume, batch](Worker& reducer, std::vector<Worker>& workers, int reducerId) {
+        reducer.shuffle(workers, reducerId);
+        reducer.reduce(batch, consume);
+    });
+}
+
+/*
+the phases of MapReduce, return the reducers after reduceStep(reducer,
+workers, reducerId) ran for each of them in parallel. with
+a spill budget, a map buffer reaching the budget is written to the spill
+file as a run and emptied, and so is a worker holding more than the budget
+after collecting its units, so the memory of the map side stays bounded.
+with a combiner the buffer is folded into a summary of its unit instead,
+summaries are small and never spilled
+*/
+template <typename ReduceStep>
+std::vector<Worker> Master :: run(Job& job, int workerNums, int reducerNums, const Combiner* combiner, ReduceStep&& reduceStep) {
+    if(reducerNums <= 0) reducerNums = workerNums;
+    std::unique_ptr<SpillFile> spillFile;
+    if(spillManager != nullptr && combiner == nullptr) {
+        static std::atomic<int> spillCount(0);
+        std::string path = spillDirectory + "/mapreduce.spill." + std::to_string(getpid()) + "." + std::to_string(spillCount++);
+        spillFile.reset(new SpillFile(*spillManager, path));
+    }
     // 1. pre-process job
-    Job optJob = preProcessor(job);
-    // 2. split the job into sub-jobs
-    std::vector<Job> subJobs = splitJob(optJob, workerNums);
-    // 3. workers receive sub-job and start mapping
-    std::vector<Worker> workers(workerNums);
+    Rectangle bound = clipQuery(job);
+    // 2. plan the work of every worker, pieces of the query or a share of the forest
+    std::vector<std::vector<MapUnit>> units = planUnits(job, bound, workerNums);
+    // 3. workers receive their units and start mapping. every unit is a task of
+    //    the pool writing to its own buffer, idle threads steal the rest
+    std::vector<Worker> workers(workerNums, Worker(reducerNums, partitioner, combiner));
+    std::vector<std::vector<std::vector<Rectangle>>> partials(workerNums);
+    std::vector<std::vector<std::vector<SpillRun>>> runs(workerNums); // runs spilled by every unit
+    std::vector<std::vector<Summary>> folded(workerNums); // values every unit folded with the combiner
+    for(int i = 0; i < workerNums; i++) {
+        partials[i].resize(units[i].size());
+        runs[i].resize(units[i].size());
+        folded[i].resize(units[i].size());
+        if(spillFile) workers[i].setSpill(spillFile.get(), spillBudget);
+        for(size_t u = 0; u < units[i].size(); u++) {
+            pool.submit([this, &job, &bound, &units, &partials, &runs, &folded, &spillFile, combiner, i, u]() {
+                const MapUnit& unit = units[i][u];
+                std::vector<Rectangle>& out = partials[i][u];
+                (*job.data)[unit.tree].queryPartition(unit.piece, bound, job.queryMode,
+                                                   [this, &out, &runs, &folded, &spillFile, &unit, combiner, i, u](const Rectangle& hit) {
+                    out.push_back(hit);
+                    if(spillManager == nullptr || out.size() < spillBudget) return;
+                    if(spillFile) runs[i][u].push_back(spillFile -> write(unit.tree, out));
+                    else combiner -> merge(folded[i][u], combiner -> combine(out));
+                    out.clear();
+                });
+            });
+        }
+    }
+    pool.wait();
+    actualCost.assign(workerNums, 0);
     for(int i = 0; i < workerNums; i++) {
-        workers.at(i).mapper(subJobs.at(i));
+        std::vector<int> keys;
+        for(size_t u = 0; u < units[i].size(); u++) {
+            keys.push_back(units[i][u].tree);
+            actualCost[i] += partials[i][u].size() + folded[i][u].count;
+            for(const SpillRun& run : runs[i][u]) {
+                actualCost[i] += run.records;
+            }
+        }
+        pool.submit([&workers, &partials, &runs, &folded, keys, i]() {
+            for(size_t u = 0; u < keys.size(); u++) {
+                for(const SpillRun& run : runs[i][u]) {
+                    workers[i].addRun(keys[u], run);
+                }
+                if(folded[i][u].count > 0) workers[i].addSummary(keys[u], std::move(folded[i][u]));
+            }
+            workers[i].collect(partials[i], keys);
+            workers[i].combine();
+        });
+    }
+    // barrier, every mapper output is complete before the shuffle
+    pool.wait();
+    // 4. reducers start shuffle and reduce in parallel, each pulls its own partition
+    std::vector<Worker> reducers(reducerNums);
+    for(int r = 0; r < reducerNums; r++) {
+        pool.submit([&reducers, &workers, &reduceStep, r]() {
+            reduceStep(reducers[r], workers, r);
+        });
     }
-    // 4. reducer start shuffle and reduce, workers[0] as reducer;
-    workers[0].shuffle_and_reduce(workers, 1);
-    return workers[0].reducing_result;
+    pool.wait();
+    return reducers;
 }
 
-// preprocess the job
-Job Master :: preProcessor(Job job) {
-    std::vector<Rectangle> finalRectSet;
-    for(Rtree tree : job.data) {
-        finalRectSet.push_back(tree.getFinalRect());
+/*
+the units of every worker. partitionMode 0 - every worker searches all trees
+with its piece of the query, cut by splitQuery. partitionMode 1 - every
+worker searches its own trees with the whole query, see assignTrees
+*/
+std::vector<std::vector<Master::MapUnit>> Master :: planUnits(const Job& job, const Rectangle& bound, int workerNums) {
+    if(partitionMode == 1) return assignTrees(job, bound, workerNums);
+    std::vector<Rectangle> pieces = splitQuery(bound, job, workerNums);
+    std::vector<int> trees = job.data -> getCatalog().overlapping(bound);
+    std::vector<std::vector<MapUnit>> units(workerNums);
+    for(int i = 0; i < workerNums; i++) {
+        for(int j : trees) {
+            units[i].push_back(MapUnit{j, pieces[i]});
+        }
     }
-    Rectangle finalUnionRect = Rectangle::unionRects(finalRectSet);
-    job.query = job.query.intersectRect(finalUnionRect);
-    return job;
+    return units;
+}
+
+/*
+split the forest instead of the query, so every tree is traversed once and
+its upper levels stay in the cache of one worker. trees are weighed by the
+expected hits of the query in them, from a few sampled leaves, and handed out
+largest first to the worker with the least expected work so far. trees the
+query does not reach are left out. the expected work of every worker is kept
+in predictedCost
+*/
+std::vector<std::vector<Master::MapUnit>> Master :: assignTrees(const Job& job, const Rectangle& bound, int workerNums) {
+    std::vector<std::pair<double, int>> trees;
+    std::vector<CostSample> samples;
+    for(int j : job.data -> getCatalog().overlapping(bound)) {
+        samples.clear();
+        sampleCost((*job.data)[j], bound, job.queryMode, TREE_SAMPLES, samples);
+        if(samples.empty()) continue;
+        double cost = 0.0;
+        for(const CostSample& sample : samples) {
+            cost += sample.weight;
+        }
+        trees.push_back(std::make_pair(cost, j));
+    }
+    std::sort(trees.begin(), trees.end(), [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<std::vector<MapUnit>> units(workerNums);
+    predictedCost.assign(workerNums, 0.0);
+    for(const std::pair<double, int>& tree : trees) {
+        int least = std::min_element(predictedCost.begin(), predictedCost.end()) - predictedCost.begin();
+        units[least].push_back(MapUnit{tree.second, bound});
+        predictedCost[least] += tree.first;
+    }
+    return units;
+}
+
+// append the sampled results of query in tree, from at most target leaves of every level
+void Master :: sampleCost(const Rtree& tree, const Rectangle& query, int queryMode, int target,
+                          std::vector<CostSample>& samples) const {
+    std::vector<std::pair<Point, double>> results;
+    tree.sampleResults(query, queryMode, target, results);
+    for(const std::pair<Point, double>& result : results) {
+        samples.push_back(CostSample{result.first, result.second});
+    }
+}
+
+// preprocess the job
+Job Master :: preProcessor(const Job& job) {
+    Job optJob = job;
+    optJob.query = clipQuery(job);
+    optJob.bound = optJob.query;
+    return optJob;
 }
 
-// divide the job into sub-jobs, which is done in the first step of MapReduce
-std::vector<Job> Master :: splitJob(Job job, int workerNums) {
+// the part of the query inside the MBR of the data, kept by the catalog
+Rectangle Master :: clipQuery(const Job& job) const {
+    return job.query.intersectRect(job.data -> getCatalog().getBound());
+}
+
+/*
+divide the job into sub-jobs, which is done in the first step of MapReduce.
+the query is cut kd-style: the region is split along its longer axis so that
+both sides hold expected work in proportion to the workers they receive, and
+each side is split again until there is one piece per worker. expected work
+comes from results sampled in a few leaves of every tree, placed at the
+reference point queryPartition reports them by, so a sample counts for the
+piece that will really find it. pieces are disjoint
+and cover the whole query, their expected hits are kept in predictedCost.
+every sub-job keeps the whole query as its bound, which decides the piece
+reporting a rectangle that reaches several pieces
+*/
+std::vector<Job> Master :: splitJob(const Job& job, int workerNums) {
     std::vector<Job> subJobs;
-    Rectangle baseQuery = job.query;
-    if(baseQuery.splitAxis()) {
-        int interval = (baseQuery.high.x - baseQuery.low.x) / workerNums;
-        Point currLow = baseQuery.low;
-        for(int i = 0; i < workerNums; i++) {
-            Point currHigh(currLow.x + interval, baseQuery.high.y);
-            Rectangle currRect(currLow, currHigh);
-            subJobs.push_back(Job(currRect, job.data));
-            currLow.x += interval;
+    for(const Rectangle& piece : splitQuery(job.query, job, workerNums)) {
+        subJobs.push_back(job);
+        subJobs.back().query = piece;
+        subJobs.back().bound = job.query;
+    }
+    return subJobs;
+}
+
+// the pieces of query over the data of job for workerNums workers, as splitJob cuts them
+std::vector<Rectangle> Master :: splitQuery(const Rectangle& query, const Job& job, int workerNums) {
+    std::vector<CostSample> samples;
+    Rectangle baseQuery = query;
+    std::vector<int> trees = job.data -> getCatalog().overlapping(baseQuery);
+    int target = (PARTITION_SAMPLES * workerNums + trees.size() - 1) / std::max<size_t>(1, trees.size());
+    for(int j : trees) {
+        sampleCost((*job.data)[j], baseQuery, job.queryMode, target, samples);
+    }
+
+    std::vector<Rectangle> pieces;
+    predictedCost.clear();
+    partition(baseQuery, workerNums, samples, 0, samples.size(), pieces);
+    return pieces;
+}
+
+/*
+cut region into parts pieces, samples[begin, end) are the samples inside it.
+the left part gets parts / 2 pieces and the cut is placed where the sample
+weight on its side comes closest to the same share of the total. the left
+side ends at the cut and the right side starts one unit after it, so no
+integer point belongs to two pieces. without samples the cut falls by width
+*/
+void Master :: partition(Rectangle region, int parts, std::vector<CostSample>& samples, int begin, int end,
+                         std::vector<Rectangle>& pieces) {
+    double total = 0.0;
+    for(int i = begin; i < end; i++) {
+        total += samples[i].weight;
+    }
+    bool byX = region.splitAxis();
+    if(byX ? region.low.x == region.high.x : region.low.y == region.high.y) byX = !byX;
+    int low = byX ? region.low.x : region.low.y;
+    int high = byX ? region.high.x : region.high.y;
+    if(parts == 1 || low >= high) {
+        // nothing left to cut, the remaining pieces are empty
+        pieces.push_back(region);
+        predictedCost.push_back(total);
+        for(int i = 1; i < parts; i++) {
+            pieces.push_back(Rectangle(Point(1, 1), Point(0, 0)));
+            predictedCost.push_back(0.0);
         }
+        return;
+    }
+
+    int leftParts = parts / 2;
+    auto coord = [byX](const CostSample& sample) { return byX ? sample.center.x : sample.center.y; };
+    std::sort(samples.begin() + begin, samples.begin() + end,
+              [&coord](const CostSample& a, const CostSample& b) { return coord(a) < coord(b); });
+    int cut;
+    if(total > 0.0) {
+        double share = total * leftParts / parts;
+        double sum = 0.0;
+        int i = begin;
+        while(i < end && std::abs(sum + samples[i].weight - share) <= std::abs(sum - share)) {
+            sum += samples[i].weight;
+            i += 1;
+        }
+        cut = i > begin ? coord(samples[i - 1]) : low;
+    } else {
+        cut = low + static_cast<int>((static_cast<double>(high) - low + 1) * leftParts / parts) - 1;
+    }
+    cut = std::min(std::max(cut, low), high - 1);
+    int middle = std::partition_point(samples.begin() + begin, samples.begin() + end,
+                                      [&coord, cut](const CostSample& sample) { return coord(sample) <= cut; }) - samples.begin();
+
+    Rectangle left = region;
+    Rectangle right = region;
+    if(byX) {
+        left.high.x = cut;
+        right.low.x = cut + 1;
     } else {
-        int interval = (baseQuery.high.y - baseQuery.low.y) / workerNums;
-        Point currLow = baseQuery.low;
-        for(int i = 0; i < workerNums; i++) {
-            Point currHigh(baseQuery.high.x, currLow.y + interval);
-            Rectangle currRect(currLow, currHigh);
-            subJobs.push_back(Job(currRect, job.data));
-            currLow.y += interval;
+        left.high.y = cut;
+        right.low.y = cut + 1;
+    }
+    partition(left, leftParts, samples, begin, middle, pieces);
+    partition(right, parts - leftParts, samples, middle, end, pieces);
+}
+
+// predicted and actual hits of every worker in the last excutor call
+std::string Master :: printCost() const {
+    std::string baseStr = "";
+    for(size_t i = 0; i < predictedCost.size(); i++) {
+        baseStr = baseStr + "Worker " + std::to_string(i) + " : predicted " + std::to_string(static_cast<long>(predictedCost[i] + 0.5));
+        if(i < actualCost.size()) baseStr = baseStr + ", actual " + std::to_string(actualCost[i]);
+        baseStr = baseStr + "\n";
+    }
+    return baseStr;
+}
+
+/*
+streaming mode of excutor: results flow to the reducers while the mappers
+are still running. a mapper hands its hits over in batches of STREAM_BATCH,
+through a bounded lock-free queue per reducer picked by the partitioner.
+reducer 0 runs on the calling thread, the others on threads of their own,
+and each calls consume(key, values) for every batch it takes, so the first
+results arrive after the first batch is found instead of after the whole
+map phase. a full queue makes the mappers wait, which bounds the memory in
+flight to the queues and one batch per running mapper. consume must be
+thread safe when reducerNums is more than 1 and must not throw
+*/
+template <typename Consumer>
+void Master :: stream(Job& job, int workerNums, Consumer&& consume, int reducerNums) {
+    if(reducerNums <= 0) reducerNums = 1;
+    // the units are planned without copying the forest into sub-jobs
+    Rectangle bound = clipQuery(job);
+    std::vector<std::vector<MapUnit>> units = planUnits(job, bound, workerNums);
+    std::vector<std::unique_ptr<BoundedQueue<StreamBatch>>> queues;
+    for(int r = 0; r < reducerNums; r++) {
+        queues.push_back(std::unique_ptr<BoundedQueue<StreamBatch>>(new BoundedQueue<StreamBatch>(STREAM_QUEUE_SIZE)));
+    }
+
+    std::atomic<int> running(0); // map tasks that may still push
+    for(int i = 0; i < workerNums; i++) {
+        running += units[i].size();
+    }
+    for(int i = 0; i < workerNums; i++) {
+        for(const MapUnit& unit : units[i]) {
+            int j = unit.tree;
+            pool.submit([this, &job, &unit, &bound, &queues, &running, reducerNums, j]() {
+                StreamBatch batch{j, std::vector<Rectangle>()};
+                BoundedQueue<StreamBatch>& queue = *queues[partitioner(j, reducerNums)];
+                auto flush = [&batch, &queue, j]() {
+                    int attempts = 0;
+                    while(!queue.tryPush(batch)) backoff(attempts);
+                    batch = StreamBatch{j, std::vector<Rectangle>()};
+                };
+                try {
+                    batch.values.reserve(STREAM_BATCH);
+                    (*job.data)[j].queryPartition(unit.piece, bound, job.queryMode, [&batch, &flush](const Rectangle& hit) {
+                        batch.values.push_back(hit);
+                        if(batch.values.size() == STREAM_BATCH) {
+                            flush();
+                            batch.values.reserve(STREAM_BATCH);
+                        }
+                    });
+                    if(!batch.values.empty()) flush();
+                } catch(...) {
+                    running -= 1;
+                    throw;
+                }
+                running -= 1;
+            });
         }
     }
-    return subJobs;
+
+    auto reducer = [&queues, &running, &consume](int r) {
+        StreamBatch batch;
+        int attempts = 0;
+        while(true) {
+            if(queues[r] -> tryPop(batch)) {
+                consume(batch.key, batch.values);
+                attempts = 0;
+            } else if(running.load() == 0) {
+                // every push happened before the last map task finished, drain what is left
+                while(queues[r] -> tryPop(batch)) consume(batch.key, batch.values);
+                return;
+            } else {
+                backoff(attempts);
+            }
+        }
+    };
+    std::vector<std::thread> reducers;
+    for(int r = 1; r < reducerNums; r++) {
+        reducers.push_back(std::thread(reducer, r));
+    }
+    reducer(0);
+    for(std::thread& thread : reducers) {
+        thread.join();
+    }
+    pool.wait();
+}
+
+/*
+run a generic job on the pool. every input is a map task whose pairs go to
+its own buffer per reducer, chosen by the job's hash of the key. with
+combine set, a task reduces its buffers itself before the shuffle. then
+reducerNums reducers, one per thread when 0, group their keys and reduce
+them in parallel. return the value of every key
+*/
+template <typename Input, typename Key, typename Value, typename Map, typename Reduce, typename Hash>
+std::map<Key, Value> Master :: execute(MapJob<Input, Key, Value, Map, Reduce, Hash>& job, int reducerNums) {
+    typedef std::vector<std::pair<Key, Value>> Buffer;
+    if(reducerNums <= 0) reducerNums = pool.size();
+    std::vector<std::vector<Buffer>> outputs(job.inputs.size(), std::vector<Buffer>(reducerNums));
+    for(size_t i = 0; i < job.inputs.size(); i++) {
+        pool.submit([&job, &outputs, reducerNums, i]() {
+            std::vector<Buffer>& output = outputs[i];
+            Hash hash;
+            auto emit = [&output, &hash, reducerNums](const Key& key, Value value) {
+                output[hash(key) % reducerNums].emplace_back(key, std::move(value));
+            };
+            job.map(job.inputs[i], emit);
+            if(!job.combine) return;
+            for(Buffer& buffer : output) {
+                std::vector<Buffer*> single(1, &buffer);
+                std::map<Key, Value> combined = reduceGroups<Key, Value>(single, job.reduce);
+                Buffer().swap(buffer);
+                for(std::pair<const Key, Value>& entry : combined) {
+                    buffer.emplace_back(entry.first, std::move(entry.second));
+                }
+            }
+        });
+    }
+    // barrier, every map task is complete before the shuffle
+    pool.wait();
+
+    std::vector<std::map<Key, Value>> reduced(reducerNums);
+    for(int r = 0; r < reducerNums; r++) {
+        pool.submit([&job, &outputs, &reduced, r]() {
+            std::vector<Buffer*> buffers;
+            for(std::vector<Buffer>& output : outputs) {
+                buffers.push_back(&output[r]);
+            }
+            reduced[r] = reduceGroups<Key, Value>(buffers, job.reduce);
+        });
+    }
+    pool.wait();
+    // every key was reduced by exactly one reducer
+    std::map<Key, Value> result;
+    for(std::map<Key, Value>& part : reduced) {
+        for(std::pair<const Key, Value>& entry : part) {
+            result.emplace(entry.first, std::move(entry.second));
+        }
+    }
+    return result;
+}
+
+// group the pairs of the buffers by key and reduce every group, the values are moved out of the buffers
+template <typename Key, typename Value, typename Reduce>
+std::map<Key, Value> Master :: reduceGroups(std::vector<std::vector<std::pair<Key, Value>>*>& buffers, Reduce& reduce) {
+    std::map<Key, std::vector<Value>> groups;
+    for(std::vector<std::pair<Key, Value>>* buffer : buffers) {
+        for(std::pair<Key, Value>& pair : *buffer) {
+            groups[pair.first].push_back(std::move(pair.second));
+        }
+        std::vector<std::pair<Key, Value>>().swap(*buffer);
+    }
+    std::map<Key, Value> result;
+    for(std::pair<const Key, std::vector<Value>>& group : groups) {
+        result.emplace(group.first, reduce(group.first, std::move(group.second)));
+    }
+    return result;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,129 @@
+#ifndef MY_QUERIES
+#define MY_QUERIES
+
+#include "mapJob.h"
+#include "combiner.h"
+#include "forest.h"
+#include "../Rtree/RTree.h"
+#include "../Rtree/spatialJoin.h"
+#include <numeric>
+
+/*
+the queries on a forest of R-Trees written as generic jobs for
+Master::execute. every map task reads one tree, or one pair of trees for
+the join. the job holds the forest by its handle, so the trees are not
+copied and stay alive as long as the job
+*/
+
+// indices 0 .. count - 1, one map task per tree
+std::vector<int> treeInputs(int count) {
+    std::vector<int> inputs(count);
+    std::iota(inputs.begin(), inputs.end(), 0);
+    return inputs;
+}
+
+/*
+range query, queryMode 0 - rectangles contained in query, 1 - rectangles
+intersecting it. one map task per tree whose root MBR the catalog finds
+reaching the query. the key is the tree, the value its answers
+*/
+auto rangeJob(ForestHandle forest, Rectangle query, int queryMode = 0) {
+    std::vector<int> inputs = forest -> getCatalog().overlapping(query);
+    auto map = [forest, query, queryMode](int tree, auto& emit) {
+        std::vector<Rectangle> hits;
+        (*forest)[tree].queryPartition(query, query, queryMode, [&hits](const Rectangle& hit) {
+            hits.push_back(hit);
+        });
+        if(!hits.empty()) emit(tree, std::move(hits));
+    };
+    auto reduce = [](int, std::vector<std::vector<Rectangle>>&& parts) {
+        std::vector<Rectangle> result = std::move(parts[0]);
+        for(size_t i = 1; i < parts.size(); i++) {
+            result.insert(result.end(), parts[i].begin(), parts[i].end());
+        }
+        return result;
+    };
+    return makeMapJob<int, std::vector<Rectangle>>(std::move(inputs), map, reduce);
+}
+
+/*
+k nearest neighbours of pt over the whole forest: every tree answers its own
+k nearest, and reduce keeps the k closest of them. the single key is 0
+*/
+auto nearestJob(ForestHandle forest, Point pt, int k) {
+    typedef std::vector<std::pair<Rectangle, double>> Neighbours;
+    int count = forest -> size();
+    auto map = [forest, pt, k](int tree, auto& emit) {
+        emit(0, (*forest)[tree].nearest(pt, k));
+    };
+    auto reduce = [k](int, std::vector<Neighbours>&& parts) {
+        Neighbours result;
+        for(Neighbours& part : parts) {
+            result.insert(result.end(), part.begin(), part.end());
+        }
+        auto closer = [](const std::pair<Rectangle, double>& a, const std::pair<Rectangle, double>& b) {
+            return a.second < b.second;
+        };
+        if(result.size() > static_cast<size_t>(k)) {
+            std::partial_sort(result.begin(), result.begin() + k, result.end(), closer);
+            result.resize(k);
+        } else {
+            std::sort(result.begin(), result.end(), closer);
+        }
+        return result;
+    };
+    return makeMapJob<int, Neighbours>(treeInputs(count), map, reduce, true);
+}
+
+/*
+spatial join of two forests, one map task per pair of trees whose MBRs
+intersect, found in the catalog of forestB. the key is the tree of forestA,
+the value its intersecting pairs
+*/
+auto joinJob(ForestHandle forestA, ForestHandle forestB) {
+    typedef std::vector<std::pair<Rectangle, Rectangle>> Pairs;
+    std::vector<std::pair<int, int>> inputs;
+    for(int i = 0; i < forestA -> size(); i++) {
+        if(forestA -> getCatalog().count(i) == 0) continue;
+        for(int j : forestB -> getCatalog().overlapping((*forestA)[i].getFinalRect())) {
+            inputs.push_back(std::make_pair(i, j));
+        }
+    }
+    auto map = [forestA, forestB](const std::pair<int, int>& trees, auto& emit) {
+        Pairs pairs;
+        spatialJoin((*forestA)[trees.first], (*forestB)[trees.second], [&pairs](const Rectangle& a, const Rectangle& b) {
+            pairs.push_back(std::make_pair(a, b));
+        });
+        if(!pairs.empty()) emit(trees.first, std::move(pairs));
+    };
+    auto reduce = [](int, std::vector<Pairs>&& parts) {
+        Pairs result = std::move(parts[0]);
+        for(size_t i = 1; i < parts.size(); i++) {
+            result.insert(result.end(), parts[i].begin(), parts[i].end());
+        }
+        return result;
+    };
+    return makeMapJob<int, Pairs>(std::move(inputs), map, reduce);
+}
+
+// aggregate of the answers of a range query in every tree it reaches, see Combiner for the modes
+auto aggregateJob(ForestHandle forest, Rectangle query, Combiner combiner, int queryMode = 0) {
+    std::vector<int> inputs = forest -> getCatalog().overlapping(query);
+    auto map = [forest, query, queryMode, combiner](int tree, auto& emit) {
+        std::vector<Rectangle> hits;
+        (*forest)[tree].queryPartition(query, query, queryMode, [&hits](const Rectangle& hit) {
+            hits.push_back(hit);
+        });
+        if(!hits.empty()) emit(tree, combiner.combine(hits));
+    };
+    auto reduce = [combiner](int, std::vector<Summary>&& parts) {
+        Summary result = std::move(parts[0]);
+        for(size_t i = 1; i < parts.size(); i++) {
+            combiner.merge(result, parts[i]);
+        }
+        return result;
+    };
+    return makeMapJob<int, Summary>(std::move(inputs), map, reduce, true);
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef MY_SPILL
+#define MY_SPILL
+
+#include "../Rtree/config.h"
+#include "../Rtree_on_disk/diskManager.h"
+#include <mutex>
+#include <string>
+
+// one key - value pair as stored on a spill page
+struct SpillRecord {
+    int key;
+    int lowX, lowY, highX, highY;
+};
+
+const int SPILL_RECORDS_PER_PAGE = (PAGE_CONTENT_SIZE - sizeof(int)) / sizeof(SpillRecord);
+
+// a run of pairs sorted by key, kept on consecutive pages of the spill file
+struct SpillRun {
+    int firstPage;
+    int pageCount;
+    long records;
+};
+
+/*
+file holding the runs workers spill when their output outgrows the memory
+budget. pages go through the FileManager / FileHandler of the disk R-Tree,
+a run is written page after page at the end of the file, so spilling and
+merging are sequential I/O. the page layer is not thread safe, every page
+access holds the file's lock. the file is removed when the object dies
+*/
+class SpillFile {
+public:
+    SpillFile(FileManager& _fileManager, const std::string& _path);
+    SpillFile(const SpillFile& other) = delete;
+    SpillFile& operator = (const SpillFile& other) = delete;
+    ~SpillFile();
+    SpillRun write(const std::vector<std::pair<int, Rectangle>>& records);
+    SpillRun write(int key, const std::vector<Rectangle>& values);
+    void readPage(int pageNum, std::vector<std::pair<int, Rectangle>>& out);
+
+private:
+    FileManager& fileManager;
+    FileHandler file;
+    std::string path;
+    std::mutex lock;
+    template <typename RecordAt>
+    SpillRun writeRecords(size_t count, RecordAt recordAt);
+};
+
+SpillFile :: SpillFile(FileManager& _fileManager, const std::string& _path) : fileManager(_fileManager),
+                                                                               file(_fileManager.createFile(_path.c_str())), path(_path) {}
+
+SpillFile :: ~SpillFile() {
+    fileManager.closeFile(file);
+    fileManager.destroyFile(path.c_str());
+}
+
+// append records, already sorted by key, as a new run
+SpillRun SpillFile :: write(const std::vector<std::pair<int, Rectangle>>& records) {
+    return writeRecords(records.size(), [&records](size_t i) {
+        return records[i];
+    });
+}
+
+// append values all sharing key as a new run
+SpillRun SpillFile :: write(int key, const std::vector<Rectangle>& values) {
+    return writeRecords(values.size(), [key, &values](size_t i) {
+        return std::make_pair(key, values[i]);
+    });
+}
+
+// write recordAt(0) .. recordAt(count - 1) on new pages at the end of the file
+template <typename RecordAt>
+SpillRun SpillFile :: writeRecords(size_t total, RecordAt recordAt) {
+    std::unique_lock<std::mutex> guard(lock);
+    SpillRun run{-1, 0, static_cast<long>(total)};
+    for(size_t begin = 0; begin < total; begin += SPILL_RECORDS_PER_PAGE) {
+        int count = std::min<size_t>(SPILL_RECORDS_PER_PAGE, total - begin);
+        PageHandler page = file.newPage();
+        char* data = page.getData();
+        memcpy(data, &count, sizeof(int));
+        SpillRecord* slots = (SpillRecord*)(data + sizeof(int));
+        for(int i = 0; i < count; i++) {
+            std::pair<int, Rectangle> record = recordAt(begin + i);
+            slots[i] = SpillRecord{record.first, record.second.low.x, record.second.low.y,
+                                   record.second.high.x, record.second.high.y};
+        }
+        if(run.firstPage == -1) run.firstPage = page.getPageNum();
+        run.pageCount += 1;
+        file.markDirty(page.getPageNum());
+        file.unpinPage(page.getPageNum());
+    }
+    return run;
+}
+
+// replace out by the records of one page
+void SpillFile :: readPage(int pageNum, std::vector<std::pair<int, Rectangle>>& out) {
+    std::unique_lock<std::mutex> guard(lock);
+    PageHandler page = file.pageAt(pageNum);
+    char* data = page.getData();
+    int count;
+    memcpy(&count, data, sizeof(int));
+    const SpillRecord* slots = (const SpillRecord*)(data + sizeof(int));
+    out.clear();
+    for(int i = 0; i < count; i++) {
+        out.push_back(std::make_pair(slots[i].key, Rectangle(Point(slots[i].lowX, slots[i].lowY),
+                                                             Point(slots[i].highX, slots[i].highY))));
+    }
+    file.unpinPage(pageNum);
+}
+
+/*
+sequential reader of one run, only the current page is held in memory.
+head() is the next record, valid while !done()
+*/
+class RunReader {
+public:
+    RunReader(SpillFile& _file, const SpillRun& _run);
+    bool done() const;
+    const std::pair<int, Rectangle>& head() const;
+    void next();
+
+private:
+    SpillFile* file;
+    SpillRun run;
+    int page; // pages of the run read so far
+    size_t position; // next record in records
+    std::vector<std::pair<int, Rectangle>> records; // records of the current page
+};
+
+RunReader :: RunReader(SpillFile& _file, const SpillRun& _run) : file(&_file), run(_run), page(0), position(0) {
+    if(run.pageCount > 0) {
+        file -> readPage(run.firstPage, records);
+        page = 1;
+    }
+}
+
+bool RunReader :: done() const {
+    return position >= records.size() && page >= run.pageCount;
+}
+
+const std::pair<int, Rectangle>& RunReader :: head() const {
+    return records[position];
+}
+
+void RunReader :: next() {
+    position += 1;
+    if(position >= records.size() && page < run.pageCount) {
+        file -> readPage(run.firstPage + page, records);
+        page += 1;
+        position = 0;
+    }
+}
+
+/*
+k-way merge of sorted runs: visit(key, value) is called for every record of
+every run in order of key, with one page per run in memory
+*/
+template <typename Visitor>
+void mergeRuns(SpillFile& file, const std::vector<SpillRun>& runs, Visitor&& visit) {
+    std::vector<RunReader> readers;
+    for(const SpillRun& run : runs) {
+        readers.push_back(RunReader(file, run));
+    }
+    // smallest key on top, ties by run so the order inside a key follows the runs
+    auto later = [&readers](int a, int b) {
+        int keyA = readers[a].head().first;
+        int keyB = readers[b].head().first;
+        return keyA != keyB ? keyA > keyB : a > b;
+    };
+    std::priority_queue<int, std::vector<int>, decltype(later)> heap(later);
+    for(size_t i = 0; i < readers.size(); i++) {
+        if(!readers[i].done()) heap.push(i);
+    }
+    while(!heap.empty()) {
+        int i = heap.top();
+        heap.pop();
+        visit(readers[i].head().first, readers[i].head().second);
+        readers[i].next();
+        if(!readers[i].done()) heap.push(i);
+    }
+}
+
+#endif
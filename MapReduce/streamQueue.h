@@ -0,0 +1,104 @@
+#ifndef MY_STREAM_QUEUE
+#define MY_STREAM_QUEUE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/*
+bounded lock-free queue for many producers and one or more consumers. the
+slots form a ring, and every slot carries a sequence number telling whether
+it is free for the push of round pos or holds the value for the pop of
+round pos, so producers and consumers only race on the position counters.
+a full queue rejects the push, which is how a slow consumer holds back the
+producers
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(int capacity);
+    BoundedQueue(const BoundedQueue& other) = delete;
+    BoundedQueue& operator = (const BoundedQueue& other) = delete;
+    bool tryPush(T& value);
+    bool tryPop(T& value);
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask; // capacity - 1, capacity is a power of two
+    alignas(64) std::atomic<size_t> tail; // position of the next push
+    alignas(64) std::atomic<size_t> head; // position of the next pop
+};
+
+// capacity is rounded up to a power of two
+template <typename T>
+BoundedQueue<T> :: BoundedQueue(int capacity) : tail(0), head(0) {
+    size_t size = 2;
+    while(size < static_cast<size_t>(capacity)) size *= 2;
+    cells.reset(new Cell[size]);
+    mask = size - 1;
+    for(size_t i = 0; i < size; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// move value into the queue, false and value untouched when the queue is full
+template <typename T>
+bool BoundedQueue<T> :: tryPush(T& value) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while(true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell -> sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if(diff == 0) {
+            if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if(diff < 0) {
+            return false;
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell -> value = std::move(value);
+    cell -> sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+// move the oldest value out of the queue, false when the queue is empty
+template <typename T>
+bool BoundedQueue<T> :: tryPop(T& value) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    Cell* cell;
+    while(true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell -> sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        if(diff == 0) {
+            if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if(diff < 0) {
+            return false;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+    value = std::move(cell -> value);
+    cell -> sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+// wait a little longer on every failed attempt: spin first, then give the cpu away
+inline void backoff(int& attempts) {
+    if(attempts < 64) {
+        attempts += 1;
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef MY_THREAD_POOL
+#define MY_THREAD_POOL
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <exception>
+
+/*
+fixed set of threads executing submitted tasks. every thread owns a queue:
+it takes its own tasks from the back and, once its queue is empty, steals
+from the front of the other queues, so a thread that finishes early helps
+with the remaining work. wait() is the barrier between two phases of a job
+*/
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadNums);
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator = (const ThreadPool& other) = delete;
+    ~ThreadPool();
+    void submit(std::function<void()> task);
+    void wait();
+    int size() const;
+
+private:
+    struct TaskQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::mutex stateLock; // guards the counters below
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    int queued; // tasks waiting in the queues
+    int pending; // tasks submitted and not finished yet
+    int nextQueue; // queue receiving the next submitted task
+    bool stopping;
+    std::exception_ptr error; // first exception thrown by a task, rethrown by wait()
+    void run(int index);
+    bool takeTask(int index, std::function<void()>& task);
+};
+
+ThreadPool :: ThreadPool(int threadNums) : queued(0), pending(0), nextQueue(0), stopping(false) {
+    if(threadNums < 1) threadNums = 1;
+    for(int i = 0; i < threadNums; i++) {
+        queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+    for(int i = 0; i < threadNums; i++) {
+        threads.push_back(std::thread(&ThreadPool::run, this, i));
+    }
+}
+
+ThreadPool :: ~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> guard(stateLock);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// hand a task to the pool, queues are filled round robin
+void ThreadPool :: submit(std::function<void()> task) {
+    int index;
+    {
+        std::unique_lock<std::mutex> guard(stateLock);
+        index = nextQueue;
+        nextQueue = (nextQueue + 1) % queues.size();
+        pending += 1;
+    }
+    {
+        std::unique_lock<std::mutex> guard(queues[index] -> lock);
+        queues[index] -> tasks.push_back(std::move(task));
+    }
+    {
+        std::unique_lock<std::mutex> guard(stateLock);
+        queued += 1;
+    }
+    taskReady.notify_one();
+}
+
+// block until every submitted task has finished
+void ThreadPool :: wait() {
+    std::unique_lock<std::mutex> guard(stateLock);
+    allDone.wait(guard, [this]() { return pending == 0; });
+    if(error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+int ThreadPool :: size() const {
+    return threads.size();
+}
+
+void ThreadPool :: run(int index) {
+    std::function<void()> task;
+    while(true) {
+        if(takeTask(index, task)) {
+            try {
+                task();
+            } catch(...) {
+                std::unique_lock<std::mutex> guard(stateLock);
+                if(!error) error = std::current_exception();
+            }
+            task = nullptr;
+            std::unique_lock<std::mutex> guard(stateLock);
+            pending -= 1;
+            if(pending == 0) allDone.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(stateLock);
+        taskReady.wait(guard, [this]() { return queued > 0 || stopping; });
+        if(stopping && queued == 0) return;
+    }
+}
+
+// newest task of the own queue first, otherwise the oldest task of another queue
+bool ThreadPool :: takeTask(int index, std::function<void()>& task) {
+    for(size_t i = 0; i < queues.size(); i++) {
+        TaskQueue& queue = *queues[(index + i) % queues.size()];
+        std::unique_lock<std::mutex> guard(queue.lock);
+        if(queue.tasks.empty()) continue;
+        if(i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        guard.unlock();
+        std::unique_lock<std::mutex> state(stateLock);
+        queued -= 1;
+        return true;
+    }
+    return false;
+}
+
+#endif
@@ -2,41 +2,230 @@
 #define MY_WORKER
 
 #include "job.h"
+#include "combiner.h"
+#include "spill.h"
+#include <functional>
+#include <iterator>
+
+// choose the reducer of a key, result in [0, reducerNums)
+typedef std::function<int(int key, int reducerNums)> Partitioner;
+
+// default partitioner, spread the keys by their hash
+int hashPartitioner(int key, int reducerNums) {
+    return std::hash<int>()(key) % reducerNums;
+}
+
+// output of a mapper bound for one reducer: runs of values sharing a key
+typedef std::vector<std::pair<int, std::vector<Rectangle>>> Partition;
+// combined output of a mapper bound for one reducer: one summary per key
+typedef std::vector<std::pair<int, Summary>> SummaryPartition;
 
 class Worker {
 public:
-    Worker() {};
-    std::map<int, Rectangle> mapping_result;
-    std::vector<Rectangle> reducing_result;
-    void mapper(const Job job);
-    void shuffle_and_reduce(std::vector<Worker> workers, int queriedKey);
+    Worker(int _reducerNums = 1, Partitioner _partitioner = hashPartitioner, const Combiner* _combiner = nullptr);
+    std::vector<Partition> mapping_result; // one partition per reducer
+    std::vector<SummaryPartition> combined_result; // one partition per reducer, replaces mapping_result when a combiner is set
+    std::map<int, std::vector<Rectangle>> reducing_result; // every value of the keys this worker reduced
+    std::map<int, Summary> reducing_summary; // merged summary of the keys this worker reduced
+    std::vector<std::vector<SpillRun>> spilled_runs; // runs on disk per reducer, sorted by key
+    void emit(int key, const Rectangle& value);
+    void emit(int key, std::vector<Rectangle>&& values);
+    void collect(std::vector<std::vector<Rectangle>>& partials, const std::vector<int>& keys);
+    void addSummary(int key, Summary&& summary);
+    void combine();
+    void setSpill(SpillFile* _spillFile, size_t _spillBudget);
+    void addRun(int key, const SpillRun& run);
+    void spill();
+    void shuffle(std::vector<Worker>& workers, int reducerId);
+    template <typename Consumer>
+    void reduce(size_t batch, Consumer&& consume);
+    void shuffle_and_reduce(std::vector<Worker>& workers, int reducerId);
+
+private:
+    int reducerNums;
+    Partitioner partitioner;
+    const Combiner* combiner; // nullptr when values are shuffled as they are
+    SpillFile* spillFile; // nullptr when the output stays in memory, the file of reducing_runs in a reducer
+    size_t spillBudget; // values held in mapping_result before they are spilled
+    size_t buffered; // values in mapping_result
+    std::map<int, Summary> folded_result; // summaries of values folded before collect, merged by combine
+    std::vector<SpillRun> reducing_runs; // runs addressed to this reducer, merged by reduce
 };
 
-// worker work as mapper, deal with their sub-job and create key-value
-void Worker :: mapper(const Job job) {
-    Rectangle subQuery = job.query;
-    // std::vector<std::vector<Rectangle>> query_result;
-    std::vector<Rectangle> query_result;
-    for(Rtree tree : job.data) {
-        Node* root = tree.getRoot();
-        // std::map<int, Node*> abc = tree.nodeMap;
-        std::vector<Rectangle> subResult = root -> queryRect(subQuery);
-        // query_result.push_back(subResult);
-        query_result.insert(query_result.end(), subResult.begin(), subResult.end());
-    }
-    // add key to the result
-    for(Rectangle queryRect : query_result) {
-        this -> mapping_result.emplace(std::make_pair(1, queryRect));
-    }
-}
-
-// worker work as reducer, shuffle the result of mapper according to their key, then reduce
-void Worker :: shuffle_and_reduce(std::vector<Worker> workers, int queriedKey) {
-    for(Worker worker : workers) {
-        for(const auto pair : worker.mapping_result) {
-            if(pair.first == queriedKey) this -> reducing_result.push_back(pair.second);
+Worker :: Worker(int _reducerNums, Partitioner _partitioner, const Combiner* _combiner) :
+                 mapping_result(std::max(1, _reducerNums)), combined_result(std::max(1, _reducerNums)),
+                 spilled_runs(std::max(1, _reducerNums)), reducerNums(std::max(1, _reducerNums)),
+                 partitioner(_partitioner), combiner(_combiner), spillFile(nullptr), spillBudget(0), buffered(0) {}
+
+// append one value to the partition of its key's reducer
+void Worker :: emit(int key, const Rectangle& value) {
+    Partition& partition = mapping_result[partitioner(key, reducerNums)];
+    if(partition.empty() || partition.back().first != key) {
+        partition.push_back(std::make_pair(key, std::vector<Rectangle>()));
+    }
+    partition.back().second.push_back(value);
+    buffered += 1;
+    if(spillFile != nullptr && buffered >= spillBudget) spill();
+}
+
+// hand a whole buffer of values sharing a key to its reducer, the buffer is moved
+void Worker :: emit(int key, std::vector<Rectangle>&& values) {
+    if(values.empty()) return;
+    Partition& partition = mapping_result[partitioner(key, reducerNums)];
+    buffered += values.size();
+    partition.push_back(std::make_pair(key, std::move(values)));
+    if(spillFile != nullptr && buffered >= spillBudget) spill();
+}
+
+// emit the hits of the worker's units, partials[u] holds the hits of unit u with key keys[u]
+void Worker :: collect(std::vector<std::vector<Rectangle>>& partials, const std::vector<int>& keys) {
+    for(size_t u = 0; u < partials.size(); u++) {
+        emit(keys[u], std::move(partials[u]));
+        std::vector<Rectangle>().swap(partials[u]);
+    }
+}
+
+// take over the summary of values of key that a unit folded itself, combine merges it with the rest of the key
+void Worker :: addSummary(int key, Summary&& summary) {
+    auto found = folded_result.find(key);
+    if(found == folded_result.end()) folded_result.emplace(key, std::move(summary));
+    else combiner -> merge(found -> second, summary);
+}
+
+/*
+run the combiner on the local output before the shuffle: the runs of every
+key in a partition are folded into one summary, together with the summaries
+passed to addSummary, and the values are released
+*/
+void Worker :: combine() {
+    if(combiner == nullptr) return;
+    std::vector<std::map<int, Summary>> summaries(reducerNums);
+    for(std::pair<const int, Summary>& summary : folded_result) {
+        summaries[partitioner(summary.first, reducerNums)].emplace(summary.first, std::move(summary.second));
+    }
+    folded_result.clear();
+    for(int r = 0; r < reducerNums; r++) {
+        for(std::pair<int, std::vector<Rectangle>>& run : mapping_result[r]) {
+            auto found = summaries[r].find(run.first);
+            if(found == summaries[r].end()) summaries[r].emplace(run.first, combiner -> combine(run.second));
+            else combiner -> merge(found -> second, combiner -> combine(run.second));
+        }
+        Partition().swap(mapping_result[r]);
+        for(std::pair<const int, Summary>& summary : summaries[r]) {
+            combined_result[r].push_back(std::make_pair(summary.first, std::move(summary.second)));
+        }
+    }
+}
+
+// spill the output to file whenever more than spillBudget values are held in memory
+void Worker :: setSpill(SpillFile* _spillFile, size_t _spillBudget) {
+    this -> spillFile = _spillFile;
+    this -> spillBudget = std::max<size_t>(1, _spillBudget);
+}
+
+// take over a run of key written by one of the worker's units
+void Worker :: addRun(int key, const SpillRun& run) {
+    spilled_runs[partitioner(key, reducerNums)].push_back(run);
+}
+
+// write every partition in memory to the spill file as a run sorted by key
+void Worker :: spill() {
+    std::vector<std::pair<int, Rectangle>> records;
+    for(int r = 0; r < reducerNums; r++) {
+        if(mapping_result[r].empty()) continue;
+        records.clear();
+        for(std::pair<int, std::vector<Rectangle>>& run : mapping_result[r]) {
+            for(const Rectangle& value : run.second) {
+                records.push_back(std::make_pair(run.first, value));
+            }
         }
+        std::stable_sort(records.begin(), records.end(),
+                         [](const std::pair<int, Rectangle>& a, const std::pair<int, Rectangle>& b) { return a.first < b.first; });
+        spilled_runs[r].push_back(spillFile -> write(records));
+        Partition().swap(mapping_result[r]);
     }
+    buffered = 0;
+}
+
+/*
+worker work as reducer reducerId: take the partition addressed to it from
+every mapper and group the values by key. partitions are moved out of the
+mappers, and a run is moved whole when its key has no value yet, so values
+are only copied when one key arrives from several mappers. summaries of
+combined mappers are merged per key by the combiner. runs spilled by the
+mappers are only collected here and left on disk for reduce
+*/
+void Worker :: shuffle(std::vector<Worker>& workers, int reducerId) {
+    for(Worker& worker : workers) {
+        if(worker.spillFile != nullptr) this -> spillFile = worker.spillFile;
+        reducing_runs.insert(reducing_runs.end(), worker.spilled_runs[reducerId].begin(), worker.spilled_runs[reducerId].end());
+        worker.spilled_runs[reducerId].clear();
+
+        SummaryPartition summaries = std::move(worker.combined_result[reducerId]);
+        worker.combined_result[reducerId].clear();
+        for(std::pair<int, Summary>& summary : summaries) {
+            auto found = this -> reducing_summary.find(summary.first);
+            if(found == this -> reducing_summary.end()) this -> reducing_summary.emplace(summary.first, std::move(summary.second));
+            else worker.combiner -> merge(found -> second, summary.second);
+        }
+        Partition partition = std::move(worker.mapping_result[reducerId]);
+        worker.mapping_result[reducerId].clear();
+        for(std::pair<int, std::vector<Rectangle>>& run : partition) {
+            std::vector<Rectangle>& values = this -> reducing_result[run.first];
+            if(values.empty()) values = std::move(run.second);
+            else values.insert(values.end(), run.second.begin(), run.second.end());
+        }
+    }
+}
+
+/*
+hand every value of the shuffled keys to consume(key, values), in order of
+key. the values of a key held in memory come first, in one call, then its
+values in the spilled runs, merged from disk with one page of each run in
+memory and handed over at most batch at a time. a key may take several
+calls, and the values are released once consumed, so a reducer never holds
+more than its share of the mappers' buffers and one batch
+*/
+template <typename Consumer>
+void Worker :: reduce(size_t batch, Consumer&& consume) {
+    batch = std::max<size_t>(1, batch);
+    auto memory = reducing_result.begin();
+    std::vector<Rectangle> values; // values of valuesKey merged from the runs and not consumed yet
+    int valuesKey = 0;
+    if(!reducing_runs.empty()) {
+        mergeRuns(*spillFile, reducing_runs, [&](int key, const Rectangle& value) {
+            if(values.size() >= batch || (!values.empty() && key != valuesKey)) {
+                consume(valuesKey, values);
+                values.clear();
+            }
+            // the keys in memory up to key go first
+            while(memory != reducing_result.end() && memory -> first <= key) {
+                consume(memory -> first, memory -> second);
+                memory = reducing_result.erase(memory);
+            }
+            valuesKey = key;
+            values.push_back(value);
+        });
+        reducing_runs.clear();
+    }
+    if(!values.empty()) consume(valuesKey, values);
+    while(memory != reducing_result.end()) {
+        consume(memory -> first, memory -> second);
+        memory = reducing_result.erase(memory);
+    }
+}
+
+// shuffle, then merge the spilled runs into reducing_result so that it holds every value of the keys
+void Worker :: shuffle_and_reduce(std::vector<Worker>& workers, int reducerId) {
+    shuffle(workers, reducerId);
+    if(reducing_runs.empty()) return;
+    std::map<int, std::vector<Rectangle>> grouped;
+    reduce(std::numeric_limits<size_t>::max(), [&grouped](int key, std::vector<Rectangle>& values) {
+        std::vector<Rectangle>& group = grouped[key];
+        if(group.empty()) group = std::move(values);
+        else group.insert(group.end(), values.begin(), values.end());
+    });
+    reducing_result.swap(grouped);
 }
 
-#endif
\ No newline at end of file
+#endif
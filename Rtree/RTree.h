@@ -2,6 +2,8 @@
 #define MY_NODE
 
 #include "./config.h"
+#include "./nodePool.h"
+#include "./nodeEntries.h"
 
 class Node;
 
@@ -10,30 +12,63 @@ class Rtree {
 public:
     const int MAX_NODE_SPACE; // maximum node capacity
     int PAGE_COUNTER; // counter for page, everytime a new node constructed, this variable add 1
-    std::map<int, Node*> nodeMap; // use std::map to store nodes in the tree
-    int splitMode; // 0 - quadratic split, 1 - linear split
+    NodePool<Node> nodeMap; // arena of the nodes in the tree, indexed by pageId
+    int splitMode; // 0 - quadratic split, 1 - linear split, 2 - R* tree
+    std::vector<int> hilbertOrder; // input positions of the rectangles in Hilbert order, filled by Hilbert packing
 
     Rtree();
     Rtree(const Rtree& other);
     Rtree(Rtree&& other) noexcept ;
     Rtree& operator=(const Rtree& other);
-    Rtree& operator=(const Rtree&& other);
-    // ~Rtree();
+    Rtree& operator=(Rtree&& other) noexcept;
+    ~Rtree();
     void initite(int parent, int pageId, int level, int nodeSpace, int _splitMode);
     void insertNode(Rectangle rect, int page);
-    Node* getRoot();
+    void bulkLoad(std::vector<Rectangle> rects, double fillFactor = 1.0, int packMode = 0);
+    Node* getRoot() const;
     Node* chooseLeaf(Rectangle rect, Node* node);
+    Node* chooseNode(Rectangle rect, int level);
     int findLeastGrowth(Rectangle rect, Node* node);
+    int findLeastOverlap(Rectangle rect, Node* node);
     Node* nextPageNumber(Node* node);
     Node** leafSplit(Node* leaf, Rectangle rect, int page);
     std::vector<std::vector<int>> LinearSplit(Node* leaf, Rectangle rect, int page);
     std::vector<std::vector<int>> QuadraticSplit(Node* leaf, Rectangle rect, int page);
+    std::vector<std::vector<int>> RStarSplit(Node* leaf, Rectangle rect, int page);
+    std::vector<std::pair<Rectangle, int>> pickReinsert(Node* node, Rectangle rect, int page);
     // std::vector<Rectangle> queryRect(Rectangle queryRect);
     int* QuadraticPickSeeds(Node* node);
     // int deleteNode(Rectangle rect);
     // void mergeTree(std::list<Node> list, Node node);
-    Rectangle getFinalRect();
+    Rectangle getFinalRect() const;
+    template <typename Visitor>
+    void query(const Rectangle& rect, Visitor&& visit) const;
+    template <typename OutputIt>
+    OutputIt queryInto(const Rectangle& rect, OutputIt out) const;
+    template <typename Visitor>
+    void queryFrom(Node* start, const Rectangle& rect, Visitor&& visit) const;
+    template <typename Visitor>
+    void queryPartition(const Rectangle& piece, const Rectangle& whole, int queryMode, Visitor&& visit) const;
+    template <typename Visitor>
+    void queryEntries(const Rectangle& rect, Visitor&& visit) const;
+    std::vector<std::pair<Rectangle, double>> nearest(Point pt, int k) const;
+    std::vector<std::vector<Rectangle>> queryBatch(const std::vector<Rectangle>& queries) const;
+    void sampleResults(const Rectangle& whole, int queryMode, int target, std::vector<std::pair<Point, double>>& out) const;
     // std::vector<Node> postOrder(Node root);
+
+private:
+    std::set<int> reinsertedLevels; // levels that did R* forced reinsertion in the running insertion
+    void insertEntry(Rectangle rect, int page);
+    void copyNodes(const Rtree& other);
+    void adoptNodes();
+    template <typename LeafMask, typename Report>
+    void searchFrom(Node* start, const Rectangle& rect, LeafMask& leafMask, Report& report) const;
+    int packCapacity(double fillFactor);
+    std::vector<std::vector<std::pair<Rectangle, int>>> strTile(std::vector<std::pair<Rectangle, int>> entries, int capacity);
+    std::vector<std::vector<std::pair<Rectangle, int>>> sequentialTile(const std::vector<std::pair<Rectangle, int>>& entries, int capacity);
+    static void hilbertSort(std::vector<std::pair<Rectangle, int>>& entries);
+    static uint64_t hilbertKey(uint32_t x, uint32_t y, int order);
+    std::vector<std::pair<Rectangle, int>> packLevel(const std::vector<std::vector<std::pair<Rectangle, int>>>& groups, int level);
 };
 
 class Node {
@@ -41,7 +76,7 @@ public:
     int level; // level of a node, 
     int pageId; // unique mark of a node, 0 for root
     int rectNums; // counter, represent the number of entries in the node
-    std::vector<Rectangle> data;
+    EntryArray data; // entries as separate coordinate arrays, see nodeEntries.h
     std::vector<int> childId;
     int parent; // parent node's pageId
     Rtree* tree; // call back pointer to the tree the node belongs to
@@ -51,6 +86,7 @@ public:
     Node(const Node& other);
     Node(Node&& other) noexcept ;
     Node& operator = (const Node& other);
+    Node& operator = (Node&& other) noexcept;
     Rectangle getNodeRectangle();
     void addData(Rectangle rect, int pageId);
     Node* getParent();
@@ -65,7 +101,6 @@ public:
     void printNode();
 };
 
-std::map<int, Node*> nodeMap;
 int PAGE_COUNTER = 0;
 const int MAX_NODE_SPACE = 10;
 
@@ -104,13 +139,23 @@ Node& Node :: operator = (const Node& other) {
     return *this;
 }
 
+Node& Node :: operator = (Node&& other) noexcept {
+    if (this != &other) {
+        level = other.level;
+        pageId = other.pageId;
+        rectNums = other.rectNums;
+        data = std::move(other.data);
+        childId = std::move(other.childId);
+        parent = other.parent;
+        tree = other.tree;
+    }
+    return *this;
+}
+
 // return the minimum bounding rectangle (MBR) of the invoking node
 Rectangle Node :: getNodeRectangle() {
     if(this -> rectNums > 0) {
-        // Rectangle result = Rectangle::unionRects(this -> data);
-        std::vector<Rectangle> subset(this -> data.begin(), this -> data.begin() + this -> rectNums);
-        Rectangle result = Rectangle::unionRects(subset);
-        return result;
+        return this -> data.bound(this -> rectNums);
     } else {
         Point emptyPoint(0.0, 0.0);
         Rectangle emptyRect(emptyPoint, emptyPoint);
@@ -120,7 +165,7 @@ Rectangle Node :: getNodeRectangle() {
 
 // add an entry into the node
 void Node :: addData(Rectangle rect, int pageId) {
-    this -> data[rectNums] = rect;
+    this -> data.set(rectNums, rect);
     this -> childId[rectNums] = pageId;
     this -> rectNums++;
 }
@@ -136,7 +181,7 @@ Node* Node :: getParent() {
 void Node :: adjustTree(Node* node1, Node* node2) {
     for(int i = 0; i < this -> rectNums; i++) {
         if(this -> childId[i] == node1 -> pageId) {
-            this -> data[i] = node1 -> getNodeRectangle();
+            this -> data.set(i, node1 -> getNodeRectangle());
             tree -> nodeMap.insert_or_assign(this -> pageId, this);
             break;
         }
@@ -155,7 +200,7 @@ void Node :: adjustTree(Node* node1, Node* node2) {
 // insert a node entry into invoker
 bool Node :: insert(Node* node) {
     if(rectNums < tree -> MAX_NODE_SPACE) {
-        data[rectNums] = node -> getNodeRectangle();
+        data.set(rectNums, node -> getNodeRectangle());
         childId[rectNums] = node -> pageId;
         rectNums += 1;
         node -> parent = pageId;
@@ -167,7 +212,19 @@ bool Node :: insert(Node* node) {
             parent -> adjustTree(this, nullptr);
         }
         return false;
+    } else if(tree -> splitMode == 2 && !isRoot() && tree -> reinsertedLevels.insert(level).second) {
+        // R*: the first overflow on this level reinserts the farthest children instead of splitting
+        std::vector<std::pair<Rectangle, int>> removed = tree -> pickReinsert(this, node -> getNodeRectangle(), node -> pageId);
+        node -> parent = pageId;
+        tree -> nextPageNumber(node);
+        getParent() -> adjustTree(this, nullptr);
+        for(const std::pair<Rectangle, int>& entry : removed) {
+            Node* child = tree -> nodeMap.at(entry.second);
+            tree -> chooseNode(entry.first, level) -> insert(child);
+        }
+        return false;
     } else {
+        node -> parent = pageId;
         Node** splitedIndex = splitIndex(node);
         Node* n1 = splitedIndex[0];
         Node* n2 = splitedIndex[1];
@@ -191,7 +248,7 @@ bool Node :: insert(Node* node) {
                 tree -> nextPageNumber(ch);
             }
 
-            Node* newRoot = new Node(-1, 0, level + 1, tree -> MAX_NODE_SPACE, tree);
+            Node* newRoot = tree -> nodeMap.create(-1, 0, level + 1, tree -> MAX_NODE_SPACE, tree);
             newRoot -> addData(n1 -> getNodeRectangle(), n1 -> pageId);
             newRoot -> addData(n2 -> getNodeRectangle(), n2 -> pageId);
             tree -> nextPageNumber(newRoot);
@@ -210,6 +267,7 @@ bool Node :: insert(Node* node) {
             Node* p = getParent();
             p -> adjustTree(n1, n2);
         }
+        delete[] splitedIndex;
     }
     return true;
 }
@@ -218,11 +276,12 @@ bool Node :: insert(Node* node) {
 Node** Node :: splitIndex(Node* node) {
     // std::vector<std::vector<int>> group = (new Rtree()) -> QuadraticSplit(this, node -> getNodeRectangle(), node ->pageId);
     std::vector<std::vector<int>> group;
-    if(tree -> splitMode == 0) group = (new Rtree()) -> QuadraticSplit(this, node -> getNodeRectangle(), node ->pageId);
-    else if(tree -> splitMode == 1) group = (new Rtree()) -> LinearSplit(this, node -> getNodeRectangle(), node ->pageId);
+    if(tree -> splitMode == 0) group = tree -> QuadraticSplit(this, node -> getNodeRectangle(), node ->pageId);
+    else if(tree -> splitMode == 1) group = tree -> LinearSplit(this, node -> getNodeRectangle(), node ->pageId);
+    else if(tree -> splitMode == 2) group = tree -> RStarSplit(this, node -> getNodeRectangle(), node ->pageId);
 
-    Node* index1 = new Node(parent, pageId, level, tree -> MAX_NODE_SPACE, tree);
-    Node* index2 = new Node(parent, -1, level, tree -> MAX_NODE_SPACE, tree);
+    Node* index1 = tree -> nodeMap.create(parent, pageId, level, tree -> MAX_NODE_SPACE, tree);
+    Node* index2 = tree -> nodeMap.create(parent, -1, level, tree -> MAX_NODE_SPACE, tree);
     std::vector<int> group1 = group[0];
     std::vector<int> group2 = group[1];
 
@@ -240,27 +299,13 @@ Node** Node :: splitIndex(Node* node) {
     return result;
 }
 
-// used to issuing a query in current node, recursively find the result
+// used to issuing a query in current node, collect the result of the subtree
 std::vector<Rectangle> Node :: queryRect(Rectangle queryRect) {
     // this -> printNode();
     std::vector<Rectangle> result;
-    if(this -> isLeaf()) {
-        for(Rectangle dataRect : this -> data) {
-            if(queryRect.cover(dataRect)) {
-                result.push_back(dataRect);
-            }
-        }
-    } else {
-        for(int i = 0; i < this -> data.size(); i++) {
-            if(this -> childId.at(i) >= 0) {
-                if(queryRect.isIntersection(data.at(i))) {
-                    Node* next = this -> tree -> nodeMap.at(this -> childId.at(i));
-                    std::vector<Rectangle> nextResult = next -> queryRect(queryRect);
-                    result.insert(result.end(), nextResult.begin(), nextResult.end());
-                }
-            }
-        }
-    }
+    tree -> queryFrom(this, queryRect, [&result](const Rectangle& hit) {
+        result.push_back(hit);
+    });
     return result;
 }
 
@@ -308,61 +353,92 @@ void Node :: printNode() {
     std::cout << baseStr << std::endl;
 }
 
-Rtree :: Rtree() : MAX_NODE_SPACE(10), PAGE_COUNTER(1000) {}
+Rtree :: Rtree() : MAX_NODE_SPACE(10), PAGE_COUNTER(0), splitMode(0) {}
 
 
 Rtree :: Rtree(const Rtree& other) : MAX_NODE_SPACE(other.MAX_NODE_SPACE), 
-                                     PAGE_COUNTER(other.PAGE_COUNTER) {
-    nodeMap = other.nodeMap;
+                                     PAGE_COUNTER(other.PAGE_COUNTER),
+                                     splitMode(other.splitMode),
+                                     hilbertOrder(other.hilbertOrder) {
+    copyNodes(other);
 }
 
 Rtree :: Rtree(Rtree&& other) noexcept : MAX_NODE_SPACE(other.MAX_NODE_SPACE), 
                                          PAGE_COUNTER(other.PAGE_COUNTER),
-                                         nodeMap(other.nodeMap) {}
+                                         nodeMap(std::move(other.nodeMap)),
+                                         splitMode(other.splitMode),
+                                         hilbertOrder(std::move(other.hilbertOrder)) {
+    adoptNodes();
+}
 
 Rtree& Rtree :: operator = (const Rtree& other) {
     if (this != &other) {
-        for (auto& pair : nodeMap) {
-            delete pair.second;
-        }
         nodeMap.clear();
         PAGE_COUNTER = other.PAGE_COUNTER;
-        for (const auto& pair : other.nodeMap) {
-            nodeMap[pair.first] = new Node(*pair.second);
-        }
+        splitMode = other.splitMode;
+        hilbertOrder = other.hilbertOrder;
+        copyNodes(other);
     }
     return *this;
 }
 
-Rtree& Rtree :: operator = (const Rtree&& other) {
+Rtree& Rtree :: operator = (Rtree&& other) noexcept {
     if(this != &other) {
         PAGE_COUNTER = other.PAGE_COUNTER;
+        splitMode = other.splitMode;
+        hilbertOrder = std::move(other.hilbertOrder);
         nodeMap = std::move(other.nodeMap);
+        adoptNodes();
     }
     return *this;
 }
 
-// Rtree :: ~Rtree () {
-//     for(auto& pair : nodeMap) {
-//         delete pair.second;
-//     }
-// }
+// all nodes live in the arena, releasing it frees the whole tree
+Rtree :: ~Rtree () {
+    nodeMap.clear();
+}
+
+// deep copy the nodes of another tree into this tree's arena
+void Rtree :: copyNodes(const Rtree& other) {
+    for(int i = 0; i < other.nodeMap.pageCount(); i++) {
+        Node* node = other.nodeMap[i];
+        if(node == nullptr) continue;
+        Node* copy = nodeMap.create(*node);
+        copy -> tree = this;
+        nodeMap.insert_or_assign(i, copy);
+    }
+}
+
+// point the call back pointer of every node to this tree, used after a move
+void Rtree :: adoptNodes() {
+    for(int i = 0; i < nodeMap.pageCount(); i++) {
+        if(nodeMap[i] != nullptr) nodeMap[i] -> tree = this;
+    }
+}
 
 // initialize a tree
 void Rtree :: initite(int parent, int pageId, int level, int nodeSpace, int _splitMode) {
-    Node *node = new Node(parent, pageId, level, nodeSpace, this);
-    this -> nodeMap.emplace(0, node);
+    Node *node = nodeMap.create(parent, pageId, level, nodeSpace, this);
+    this -> nodeMap.insert_or_assign(0, node);
     this -> splitMode = _splitMode;
 }
 
 // return the root of current tree
-Node* Rtree :: getRoot() {
+Node* Rtree :: getRoot() const {
     return nodeMap.at(0);
 }
 
 
 // insert a rectangle into Rtree
 void Rtree :: insertNode(Rectangle rect, int page) {
+    reinsertedLevels.clear();
+    insertEntry(rect, page);
+    // nodes replaced by splits are no longer referenced, their slots can be reused
+    nodeMap.reclaim();
+}
+
+// place a rectangle into a leaf, splitting or reinserting on overflow
+void Rtree :: insertEntry(Rectangle rect, int page) {
     Node* leaf;
     int currentPage;
     Node* root = nodeMap.at(0);
@@ -374,9 +450,7 @@ void Rtree :: insertNode(Rectangle rect, int page) {
     }
 
     if(leaf -> rectNums < MAX_NODE_SPACE) {
-        int a = leaf -> data.capacity();
-        int b = leaf -> data.size();
-        leaf -> data.at(leaf -> rectNums) = rect;
+        leaf -> data.set(leaf -> rectNums, rect);
         leaf -> childId.at(leaf -> rectNums) = page;
         leaf -> rectNums += 1;
         nodeMap.insert_or_assign(leaf -> pageId, leaf);
@@ -384,6 +458,13 @@ void Rtree :: insertNode(Rectangle rect, int page) {
         if(parent != nullptr) {
             parent -> adjustTree(leaf, nullptr);
         }
+    } else if(splitMode == 2 && !leaf -> isRoot() && reinsertedLevels.insert(0).second) {
+        // R*: the first leaf overflow of an insertion reinserts the farthest entries instead of splitting
+        std::vector<std::pair<Rectangle, int>> removed = pickReinsert(leaf, rect, page);
+        leaf -> getParent() -> adjustTree(leaf, nullptr);
+        for(const std::pair<Rectangle, int>& entry : removed) {
+            insertEntry(entry.first, entry.second);
+        }
     } else {
         Node** nodes = leafSplit(leaf, rect, page);
         Node* n1 = nodes[0];
@@ -397,7 +478,7 @@ void Rtree :: insertNode(Rectangle rect, int page) {
             n1 = nextPageNumber(n1);
             n2 = nextPageNumber(n2);
 
-            Node* node = new Node(-1, 0, 1, MAX_NODE_SPACE, this);
+            Node* node = nodeMap.create(-1, 0, 1, MAX_NODE_SPACE, this);
             node -> addData(n1 -> getNodeRectangle(), n1 -> pageId);
             node -> addData(n2 -> getNodeRectangle(), n2 -> pageId);
             // nodeMap.emplace(0, node);
@@ -410,6 +491,7 @@ void Rtree :: insertNode(Rectangle rect, int page) {
             Node* parentNode = leaf -> getParent();
             parentNode -> adjustTree(n1, n2);
         }
+        delete[] nodes;
     }
 }
 
@@ -418,7 +500,9 @@ given a rectangle, recursively find the leaf node
 where the rectangle should be insert
 */
 Node* Rtree :: chooseLeaf(Rectangle rect, Node* node) {
-    int index = findLeastGrowth(rect, node);
+    int index;
+    if(splitMode == 2 && node -> level == 1) index = findLeastOverlap(rect, node);
+    else index = findLeastGrowth(rect, node);
     Node* descent = node -> getChild(index);
     if(node -> level == 1) {
         return descent;
@@ -426,6 +510,15 @@ Node* Rtree :: chooseLeaf(Rectangle rect, Node* node) {
     return chooseLeaf(rect, descent);
 }
 
+// descend from the root to the node on the given level where an entry of rect should be insert
+Node* Rtree :: chooseNode(Rectangle rect, int level) {
+    Node* node = getRoot();
+    while(node -> level > level) {
+        node = node -> getChild(findLeastGrowth(rect, node));
+    }
+    return node;
+}
+
 /*
 given a rectangle, choose the index of a rectangle in the node, 
 which has the least area growth
@@ -446,15 +539,46 @@ int Rtree :: findLeastGrowth(Rectangle rect, Node* node) {
     return sel;
 }
 
+/*
+R* ChooseSubtree for nodes whose children are leaves: choose the index whose
+enlargement adds the least overlap with the other entries, ties are broken
+by least area growth and then least area
+*/
+int Rtree :: findLeastOverlap(Rectangle rect, Node* node) {
+    double bestOverlap = std::numeric_limits<double>::infinity();
+    double bestGrow = std::numeric_limits<double>::infinity();
+    double bestArea = std::numeric_limits<double>::infinity();
+    int sel = -1;
+
+    for(int i = 0; i < node -> rectNums; i++) {
+        Rectangle enlarged = node -> data[i].unionRect(rect);
+        double overlap = 0.0;
+        for(int j = 0; j < node -> rectNums; j++) {
+            if(j == i) continue;
+            overlap += enlarged.getIntersectionArea(node -> data[j]) - node -> data[i].getIntersectionArea(node -> data[j]);
+        }
+        double area = node -> data[i].getArea();
+        double grow = enlarged.getArea() - area;
+        if(overlap < bestOverlap || (overlap == bestOverlap && (grow < bestGrow || (grow == bestGrow && area < bestArea)))) {
+            bestOverlap = overlap;
+            bestGrow = grow;
+            bestArea = area;
+            sel = i;
+        }
+    }
+    return sel;
+}
+
 // split leaf when it overflow
 Node** Rtree :: leafSplit(Node* leaf, Rectangle rect, int page) {
     // std::vector<std::vector<int>> group = QuadraticSplit(leaf, rect, page);
     std::vector<std::vector<int>> group;
     if(this -> splitMode == 0) group = QuadraticSplit(leaf, rect, page);
     else if(this -> splitMode == 1) group = LinearSplit(leaf, rect, page);
+    else if(this -> splitMode == 2) group = RStarSplit(leaf, rect, page);
 
-    Node* n1 = new Node(leaf -> parent, -1, 0, MAX_NODE_SPACE, this);
-    Node* n2 = new Node(leaf -> parent, -1, 0, MAX_NODE_SPACE, this);
+    Node* n1 = nodeMap.create(leaf -> parent, -1, 0, MAX_NODE_SPACE, this);
+    Node* n2 = nodeMap.create(leaf -> parent, -1, 0, MAX_NODE_SPACE, this);
     std::vector<int> group1 = group[0];
     std::vector<int> group2 = group[1];
 
@@ -478,7 +602,7 @@ Node* Rtree :: nextPageNumber(Node* node) {
         node -> pageId = this -> PAGE_COUNTER + 1;
         PAGE_COUNTER += 1;
     }
-    Rtree::nodeMap.insert_or_assign(node -> pageId, node);
+    nodeMap.insert_or_assign(node -> pageId, node);
     return node;
 }
 
@@ -487,21 +611,17 @@ std::vector<std::vector<int>> Rtree :: LinearSplit(Node* leaf, Rectangle rect, i
     leaf -> childId.push_back(page);
     int total = leaf -> rectNums + 1;
 
-    std::vector<double> midPtX;
-    double midX;
-    for(Rectangle entry : leaf -> data) {
-        midPtX.push_back(entry.getMidPoint().x);
-    }
-    std::sort(midPtX.begin(), midPtX.end());
-    if(midPtX.size() % 2 == 0) midX = (midPtX[midPtX.size() / 2 - 1] + midPtX[midPtX.size() / 2]) / 2.0;
-    else midX = midPtX[midPtX.size() / 2];
-
-    std::vector<int> group1;
-    std::vector<int> group2;
+    // order the entries by the x of their centers and cut at the median
+    std::vector<int> order(total);
     for(int i = 0; i < total; i++) {
-        if(leaf -> data.at(i).getMidPoint().x < midX) group1.push_back(leaf -> childId.at(i));
-        else group2.push_back(leaf -> childId.at(i));
+        order[i] = i;
     }
+    std::sort(order.begin(), order.end(), [leaf](int a, int b) {
+        return leaf -> data[a].getMidPoint().x < leaf -> data[b].getMidPoint().x;
+    });
+
+    std::vector<int> group1(order.begin(), order.begin() + total / 2);
+    std::vector<int> group2(order.begin() + total / 2, order.end());
 
     std::vector<std::vector<int>> result = {group1, group2};
     return result;
@@ -649,7 +769,7 @@ int* Rtree :: QuadraticPickSeeds(Node* node) {
     result[1] = 0;
 
     for(int i = 0; i < node -> rectNums; i++) {
-        for(int j = 0; j < node -> rectNums; j++) {
+        for(int j = i + 1; j < node -> rectNums; j++) {
             Rectangle cover = node -> data[i].unionRect(node -> data[j]);
             double diff = cover.getArea() - node -> data[i].getArea() - node -> data[j].getArea();
             if(diff > inefficiency) {
@@ -662,8 +782,561 @@ int* Rtree :: QuadraticPickSeeds(Node* node) {
     return result;
 }
 
+// range query over the whole tree, visit(const Rectangle&) is called for every covered rectangle
+template <typename Visitor>
+void Rtree :: query(const Rectangle& rect, Visitor&& visit) const {
+    queryFrom(nodeMap.at(0), rect, visit);
+}
+
+// range query writing every covered rectangle to an output iterator
+template <typename OutputIt>
+OutputIt Rtree :: queryInto(const Rectangle& rect, OutputIt out) const {
+    queryFrom(nodeMap.at(0), rect, [&out](const Rectangle& hit) {
+        *out++ = hit;
+    });
+    return out;
+}
+
+// range query below start, every rectangle covered by rect is handed to visit
+template <typename Visitor>
+void Rtree :: queryFrom(Node* start, const Rectangle& rect, Visitor&& visit) const {
+    auto leafMask = [&rect](Node* leaf, int begin, int count) {
+        return leaf -> data.coverMask(rect, begin, count);
+    };
+    auto report = [&visit](Node* leaf, int i) {
+        visit(leaf -> data[i]);
+    };
+    searchFrom(start, rect, leafMask, report);
+}
+
+/*
+the share of a partitioned range query that belongs to piece, one of disjoint
+pieces covering whole. queryMode 0 - rectangles covered by whole, 1 -
+rectangles intersecting whole. a rectangle reaching several pieces is only
+reported by the piece holding its reference point, the lower left corner of
+its intersection with whole, so the pieces together report every result
+exactly once and nothing has to be deduplicated afterwards
+*/
+template <typename Visitor>
+void Rtree :: queryPartition(const Rectangle& piece, const Rectangle& whole, int queryMode, Visitor&& visit) const {
+    if(piece.low.x > piece.high.x || piece.low.y > piece.high.y) return;
+    auto leafMask = [&piece, &whole, queryMode](Node* leaf, int begin, int count) {
+        uint32_t mask = leaf -> data.intersectMask(piece, begin, count);
+        if(queryMode == 0) mask &= leaf -> data.coverMask(whole, begin, count);
+        for(uint32_t rest = mask; rest != 0; rest &= rest - 1) {
+            int i = begin + lowestBit(rest);
+            Point reference(std::max(leaf -> data.lowX()[i], whole.low.x), std::max(leaf -> data.lowY()[i], whole.low.y));
+            if(!piece.cover(reference)) mask &= ~(1u << (i - begin));
+        }
+        return mask;
+    };
+    auto report = [&visit](Node* leaf, int i) {
+        visit(leaf -> data[i]);
+    };
+    searchFrom(nodeMap.at(0), piece, leafMask, report);
+}
+
+/*
+every rectangle intersecting rect together with the id it was stored with,
+visit(const Rectangle&, int): the page passed to insertNode, or the position
+in the input of bulkLoad
+*/
+template <typename Visitor>
+void Rtree :: queryEntries(const Rectangle& rect, Visitor&& visit) const {
+    auto leafMask = [&rect](Node* leaf, int begin, int count) {
+        return leaf -> data.intersectMask(rect, begin, count);
+    };
+    auto report = [&visit](Node* leaf, int i) {
+        visit(leaf -> data[i], leaf -> childId[i]);
+    };
+    searchFrom(nodeMap.at(0), rect, leafMask, report);
+}
+
+/*
+iterative search below start. pending nodes are kept on a fixed size stack,
+and hits are handed to visit as soon as a leaf produces them, so no result
+is buffered. entries are tested MASK_BLOCK at a time by the vector kernels,
+which return a bitmask of the entries to descend into (index, entries
+intersecting rect) or to report (leaf, decided by leafMask, handed to
+report(leaf, index)). a subtree that would overflow the stack is searched
+by a nested call
+*/
+template <typename LeafMask, typename Report>
+void Rtree :: searchFrom(Node* start, const Rectangle& rect, LeafMask& leafMask, Report& report) const {
+    Node* stack[QUERY_STACK_SIZE];
+    int top = 0;
+    stack[top++] = start;
+    while(top > 0) {
+        Node* node = stack[--top];
+        for(int begin = 0; begin < node -> rectNums; begin += MASK_BLOCK) {
+            int count = std::min(MASK_BLOCK, node -> rectNums - begin);
+            if(node -> isLeaf()) {
+                uint32_t mask = leafMask(node, begin, count);
+                while(mask != 0) {
+                    report(node, begin + lowestBit(mask));
+                    mask &= mask - 1;
+                }
+            } else {
+                uint32_t mask = node -> data.intersectMask(rect, begin, count);
+                while(mask != 0) {
+                    Node* next = nodeMap.at(node -> childId[begin + lowestBit(mask)]);
+                    if(top < QUERY_STACK_SIZE) stack[top++] = next;
+                    else searchFrom(next, rect, leafMask, report);
+                    mask &= mask - 1;
+                }
+            }
+        }
+    }
+}
+
+/*
+answer a batch of range queries in one traversal. the queries are ordered
+along the Hilbert curve and pushed through the tree together: a node is read
+once for all queries that reach it, and each of its entries is tested against
+the active queries only, which are passed on to the children they intersect.
+the active query lists of pending nodes share one buffer, which the
+depth-first order lets shrink whenever a node is popped. return the
+covered rectangles of every query, in the order of queries
+*/
+std::vector<std::vector<Rectangle>> Rtree :: queryBatch(const std::vector<Rectangle>& queries) const {
+    struct Frame {
+        Node* node;
+        int offset; // position of the node's active queries in active
+        int length;
+    };
+
+    std::vector<std::vector<Rectangle>> result(queries.size());
+    Node* root = nodeMap.at(0);
+    if(queries.empty() || root -> rectNums == 0) return result;
+
+    std::vector<std::pair<Rectangle, int>> ordered;
+    ordered.reserve(queries.size());
+    for(int i = 0; i < queries.size(); i++) {
+        ordered.push_back(std::make_pair(queries[i], i));
+    }
+    hilbertSort(ordered);
+
+    std::vector<int> active;
+    active.reserve(queries.size());
+    for(const std::pair<Rectangle, int>& query : ordered) {
+        active.push_back(query.second);
+    }
+    std::vector<Frame> stack;
+    stack.push_back(Frame{root, 0, static_cast<int>(active.size())});
+    std::vector<uint32_t> masks;
+
+    while(!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
+        active.resize(frame.offset + frame.length);
+        Node* node = frame.node;
+
+        for(int begin = 0; begin < node -> rectNums; begin += MASK_BLOCK) {
+            int count = std::min(MASK_BLOCK, node -> rectNums - begin);
+            if(node -> isLeaf()) {
+                for(int q = frame.offset; q < frame.offset + frame.length; q++) {
+                    uint32_t mask = node -> data.coverMask(queries[active[q]], begin, count);
+                    while(mask != 0) {
+                        result[active[q]].push_back(node -> data[begin + lowestBit(mask)]);
+                        mask &= mask - 1;
+                    }
+                }
+                continue;
+            }
+
+            masks.clear();
+            uint32_t reached = 0;
+            for(int q = frame.offset; q < frame.offset + frame.length; q++) {
+                masks.push_back(node -> data.intersectMask(queries[active[q]], begin, count));
+                reached |= masks.back();
+            }
+            while(reached != 0) {
+                int i = lowestBit(reached);
+                int offset = active.size();
+                for(int q = 0; q < frame.length; q++) {
+                    if(masks[q] & (1u << i)) active.push_back(active[frame.offset + q]);
+                }
+                stack.push_back(Frame{nodeMap.at(node -> childId[begin + i]), offset, static_cast<int>(active.size()) - offset});
+                reached &= reached - 1;
+            }
+        }
+    }
+    return result;
+}
+
+/*
+k nearest neighbour query, best-first: nodes and rectangles wait in one
+priority queue ordered by MINDIST to pt, so a rectangle popped from the queue
+is closer than everything not yet seen. an entry is not queued when its
+MINDIST exceeds a distance that is known to hold k objects, the k-th smallest
+MINMAXDIST among the entries of an internal node or the k-th smallest MINDIST
+among the rectangles of a leaf. return the k closest rectangles with their
+euclidean distances, nearest first
+*/
+std::vector<std::pair<Rectangle, double>> Rtree :: nearest(Point pt, int k) const {
+    struct Candidate {
+        double dist; // squared MINDIST
+        Node* node; // nullptr when the candidate is a rectangle
+        Rectangle rect;
+        bool operator < (const Candidate& other) const {
+            return dist > other.dist;
+        }
+    };
+
+    std::vector<std::pair<Rectangle, double>> result;
+    Node* root = nodeMap.at(0);
+    if(k <= 0 || root -> rectNums == 0) return result;
+
+    std::priority_queue<Candidate> queue;
+    double pruneDist = std::numeric_limits<double>::infinity();
+    queue.push(Candidate{0.0, root, Rectangle()});
+    std::vector<double> bounds;
+
+    while(!queue.empty() && result.size() < k) {
+        Candidate top = queue.top();
+        queue.pop();
+        if(top.node == nullptr) {
+            result.push_back(std::make_pair(top.rect, std::sqrt(top.dist)));
+            continue;
+        }
+        if(top.dist > pruneDist) continue;
+
+        Node* node = top.node;
+        // every entry holds at least one object within its bound, k entries bound the k-th neighbour
+        bounds.clear();
+        for(int i = 0; i < node -> rectNums; i++) {
+            Rectangle entry = node -> data[i];
+            bounds.push_back(node -> isLeaf() ? entry.getMinDist(pt) : entry.getMaxMinDist(pt));
+        }
+        if(bounds.size() >= k) {
+            std::nth_element(bounds.begin(), bounds.begin() + (k - 1), bounds.end());
+            pruneDist = std::min(pruneDist, bounds[k - 1]);
+        }
+
+        for(int i = 0; i < node -> rectNums; i++) {
+            Rectangle entry = node -> data[i];
+            double dist = entry.getMinDist(pt);
+            if(dist > pruneDist) continue;
+            if(node -> isLeaf()) queue.push(Candidate{dist, nullptr, entry});
+            else queue.push(Candidate{dist, nodeMap.at(node -> childId[i]), entry});
+        }
+    }
+    return result;
+}
+
+/*
+build the tree bottom-up from a set of rectangles, replacing the current content
+of the tree. packMode 0 - Sort-Tile-Recursive, 1 - Hilbert packing. every node is
+filled up to fillFactor * MAX_NODE_SPACE entries, the entry of a rectangle in a
+leaf keeps its position in rects as childId
+*/
+void Rtree :: bulkLoad(std::vector<Rectangle> rects, double fillFactor, int packMode) {
+    int capacity = packCapacity(fillFactor);
+    nodeMap.clear();
+    PAGE_COUNTER = 0;
+    hilbertOrder.clear();
+
+    std::vector<std::pair<Rectangle, int>> entries;
+    entries.reserve(rects.size());
+    for(int i = 0; i < rects.size(); i++) {
+        entries.push_back(std::make_pair(rects[i], i));
+    }
+
+    if(packMode == 1) {
+        // leaves and every level above are cut in curve order, so leaves get consecutive pages along the curve
+        hilbertSort(entries);
+        for(const std::pair<Rectangle, int>& entry : entries) {
+            hilbertOrder.push_back(entry.second);
+        }
+    }
+
+    int level = 0;
+    do {
+        if(packMode == 1) entries = packLevel(sequentialTile(entries, capacity), level);
+        else entries = packLevel(strTile(entries, capacity), level);
+        level += 1;
+    } while(entries.size() > 1);
+}
+
+// number of entries per node when packing with the given fill factor
+int Rtree :: packCapacity(double fillFactor) {
+    if(fillFactor <= 0.0 || fillFactor > 1.0) fillFactor = 1.0;
+    int capacity = static_cast<int>(MAX_NODE_SPACE * fillFactor);
+    return std::max(2, std::min(capacity, MAX_NODE_SPACE));
+}
+
+/*
+group the entries of one level into runs of at most capacity entries:
+sort by the x of the centers, cut into vertical slices of
+ceil(sqrt(nodes)) runs, then sort every slice by the y of the centers
+*/
+std::vector<std::vector<std::pair<Rectangle, int>>> Rtree :: strTile(std::vector<std::pair<Rectangle, int>> entries, int capacity) {
+    std::vector<std::vector<std::pair<Rectangle, int>>> groups;
+    int total = entries.size();
+    int nodeCount = (total + capacity - 1) / capacity;
+    int sliceCount = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(nodeCount))));
+    int sliceSize = sliceCount * capacity;
+
+    std::sort(entries.begin(), entries.end(), [](const std::pair<Rectangle, int>& a, const std::pair<Rectangle, int>& b) {
+        return a.first.low.x + a.first.high.x < b.first.low.x + b.first.high.x;
+    });
+    for(int begin = 0; begin < total; begin += sliceSize) {
+        int end = std::min(begin + sliceSize, total);
+        std::sort(entries.begin() + begin, entries.begin() + end, [](const std::pair<Rectangle, int>& a, const std::pair<Rectangle, int>& b) {
+            return a.first.low.y + a.first.high.y < b.first.low.y + b.first.high.y;
+        });
+        for(int i = begin; i < end; i += capacity) {
+            groups.push_back(std::vector<std::pair<Rectangle, int>>(entries.begin() + i, entries.begin() + std::min(i + capacity, end)));
+        }
+    }
+    return groups;
+}
+
+// cut the entries into runs of capacity entries, keeping their order
+std::vector<std::vector<std::pair<Rectangle, int>>> Rtree :: sequentialTile(const std::vector<std::pair<Rectangle, int>>& entries, int capacity) {
+    std::vector<std::vector<std::pair<Rectangle, int>>> groups;
+    for(int i = 0; i < entries.size(); i += capacity) {
+        int end = std::min(i + capacity, static_cast<int>(entries.size()));
+        groups.push_back(std::vector<std::pair<Rectangle, int>>(entries.begin() + i, entries.begin() + end));
+    }
+    return groups;
+}
+
+// sort entries by the Hilbert key of their centers, scaled onto the curve's grid
+void Rtree :: hilbertSort(std::vector<std::pair<Rectangle, int>>& entries) {
+    if(entries.empty()) return;
+    std::vector<Point> mids;
+    mids.reserve(entries.size());
+    for(std::pair<Rectangle, int>& entry : entries) {
+        mids.push_back(entry.first.getMidPoint());
+    }
+    int minX = mids[0].x, minY = mids[0].y, maxX = mids[0].x, maxY = mids[0].y;
+    for(const Point& pt : mids) {
+        minX = std::min(minX, pt.x);
+        minY = std::min(minY, pt.y);
+        maxX = std::max(maxX, pt.x);
+        maxY = std::max(maxY, pt.y);
+    }
+    double side = static_cast<double>((1u << HILBERT_ORDER) - 1);
+    double scaleX = maxX > minX ? side / (static_cast<double>(maxX) - minX) : 0.0;
+    double scaleY = maxY > minY ? side / (static_cast<double>(maxY) - minY) : 0.0;
+
+    std::vector<std::pair<uint64_t, int>> keys;
+    keys.reserve(entries.size());
+    for(int i = 0; i < mids.size(); i++) {
+        uint32_t gx = static_cast<uint32_t>((mids[i].x - static_cast<double>(minX)) * scaleX);
+        uint32_t gy = static_cast<uint32_t>((mids[i].y - static_cast<double>(minY)) * scaleY);
+        keys.push_back(std::make_pair(hilbertKey(gx, gy, HILBERT_ORDER), i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<std::pair<Rectangle, int>> sorted;
+    sorted.reserve(entries.size());
+    for(const std::pair<uint64_t, int>& key : keys) {
+        sorted.push_back(entries[key.second]);
+    }
+    entries.swap(sorted);
+}
+
+// distance of grid cell (x, y) along the Hilbert curve of the given order
+uint64_t Rtree :: hilbertKey(uint32_t x, uint32_t y, int order) {
+    uint64_t d = 0;
+    for(uint32_t s = 1u << (order - 1); s > 0; s >>= 1) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // rotate the quadrant so the sub-curve has the standard orientation
+        if(ry == 0) {
+            if(rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+/*
+create one node per group on the given level and return their (MBR, pageId)
+as the entries of the level above. a single group becomes the root on page 0
+*/
+std::vector<std::pair<Rectangle, int>> Rtree :: packLevel(const std::vector<std::vector<std::pair<Rectangle, int>>>& groups, int level) {
+    std::vector<std::pair<Rectangle, int>> upper;
+    if(groups.empty()) {
+        Node* root = nodeMap.create(-1, 0, level, MAX_NODE_SPACE, this);
+        nodeMap.insert_or_assign(0, root);
+        return upper;
+    }
+
+    bool isRoot = groups.size() == 1;
+    for(const std::vector<std::pair<Rectangle, int>>& group : groups) {
+        Node* node = nodeMap.create(-1, isRoot ? 0 : -1, level, MAX_NODE_SPACE, this);
+        for(const std::pair<Rectangle, int>& entry : group) {
+            node -> addData(entry.first, entry.second);
+        }
+        nextPageNumber(node);
+        if(level > 0) {
+            for(int i = 0; i < node -> rectNums; i++) {
+                node -> getChild(i) -> parent = node -> pageId;
+            }
+        }
+        upper.push_back(std::make_pair(node -> getNodeRectangle(), node -> pageId));
+    }
+    return upper;
+}
+
+/*
+R* split: for both axes sort the entries by their lower and by their upper
+bound, and take the axis whose distributions have the smallest sum of margins.
+on that axis, the distribution with the least overlap between the two groups
+wins, ties are broken by the least total area
+*/
+std::vector<std::vector<int>> Rtree :: RStarSplit(Node* leaf, Rectangle rect, int page) {
+    leaf -> data.push_back(rect);
+    leaf -> childId.push_back(page);
+    int total = leaf -> rectNums + 1;
+    int minFill = std::max(1, static_cast<int>(MAX_NODE_SPACE * RSTAR_MIN_FILL));
+
+    // sortings[2 * axis + bound], axis 0 - x, 1 - y, bound 0 - low, 1 - high
+    std::vector<std::vector<int>> sortings(4, std::vector<int>(total));
+    for(int s = 0; s < 4; s++) {
+        for(int i = 0; i < total; i++) {
+            sortings[s][i] = i;
+        }
+        const int* key = (s == 0) ? leaf -> data.lowX() : (s == 1) ? leaf -> data.highX() :
+                         (s == 2) ? leaf -> data.lowY() : leaf -> data.highY();
+        std::sort(sortings[s].begin(), sortings[s].end(), [key](int a, int b) {
+            return key[a] < key[b];
+        });
+    }
+
+    // MBRs of the first k and the last total - k entries of every sorting
+    std::vector<std::vector<Rectangle>> prefix(4, std::vector<Rectangle>(total));
+    std::vector<std::vector<Rectangle>> suffix(4, std::vector<Rectangle>(total));
+    for(int s = 0; s < 4; s++) {
+        prefix[s][0] = leaf -> data[sortings[s][0]];
+        for(int i = 1; i < total; i++) {
+            prefix[s][i] = prefix[s][i - 1].unionRect(leaf -> data[sortings[s][i]]);
+        }
+        suffix[s][total - 1] = leaf -> data[sortings[s][total - 1]];
+        for(int i = total - 2; i >= 0; i--) {
+            suffix[s][i] = suffix[s][i + 1].unionRect(leaf -> data[sortings[s][i]]);
+        }
+    }
+
+    double marginSum[2] = {0.0, 0.0};
+    for(int s = 0; s < 4; s++) {
+        for(int k = minFill; k <= total - minFill; k++) {
+            marginSum[s / 2] += prefix[s][k - 1].getMargin() + suffix[s][k].getMargin();
+        }
+    }
+    int axis = (marginSum[0] <= marginSum[1]) ? 0 : 1;
+
+    double bestOverlap = std::numeric_limits<double>::infinity();
+    double bestArea = std::numeric_limits<double>::infinity();
+    int bestSorting = 2 * axis;
+    int bestK = total / 2;
+    for(int s = 2 * axis; s < 2 * axis + 2; s++) {
+        for(int k = minFill; k <= total - minFill; k++) {
+            double overlap = prefix[s][k - 1].getIntersectionArea(suffix[s][k]);
+            double area = prefix[s][k - 1].getArea() + suffix[s][k].getArea();
+            if(overlap < bestOverlap || (overlap == bestOverlap && area < bestArea)) {
+                bestOverlap = overlap;
+                bestArea = area;
+                bestSorting = s;
+                bestK = k;
+            }
+        }
+    }
+
+    std::vector<int> group1(sortings[bestSorting].begin(), sortings[bestSorting].begin() + bestK);
+    std::vector<int> group2(sortings[bestSorting].begin() + bestK, sortings[bestSorting].end());
+    std::vector<std::vector<int>> result = {group1, group2};
+    return result;
+}
+
+/*
+R* forced reinsertion: take the entries of an overflowing node together with
+the new entry, keep the ones closest to the center of their MBR in the node
+and return the farthest RSTAR_REINSERT_FRACTION, closest first
+*/
+std::vector<std::pair<Rectangle, int>> Rtree :: pickReinsert(Node* node, Rectangle rect, int page) {
+    std::vector<std::pair<Rectangle, int>> entries;
+    std::vector<Rectangle> rects;
+    for(int i = 0; i < node -> rectNums; i++) {
+        entries.push_back(std::make_pair(node -> data[i], node -> childId[i]));
+        rects.push_back(node -> data[i]);
+    }
+    entries.push_back(std::make_pair(rect, page));
+    rects.push_back(rect);
+
+    Point center = Rectangle::unionRects(rects).getMidPoint();
+    std::stable_sort(entries.begin(), entries.end(), [center](std::pair<Rectangle, int> a, std::pair<Rectangle, int> b) {
+        return a.first.getMidPoint().getDist(center) < b.first.getMidPoint().getDist(center);
+    });
+
+    int removeCount = std::max(1, static_cast<int>(MAX_NODE_SPACE * RSTAR_REINSERT_FRACTION));
+    int keepCount = entries.size() - removeCount;
+    node -> rectNums = 0;
+    node -> data.assign(MAX_NODE_SPACE, Rectangle(Point(), Point()));
+    node -> childId.assign(MAX_NODE_SPACE, -1);
+    for(int i = 0; i < keepCount; i++) {
+        node -> addData(entries[i].first, entries[i].second);
+    }
+    return std::vector<std::pair<Rectangle, int>>(entries.begin() + keepCount, entries.end());
+}
+
+/*
+estimate where the results of a query over whole lie, as queryPartition
+hands them out. the nodes reaching whole are expanded level by level; when a
+level holds more than target of them, target nodes spread evenly over it are
+kept and each stands for the ones skipped. the results in the kept leaves are
+appended to out with their reference point, which decides the piece that
+reports them, and the number of results they stand for
+*/
+void Rtree :: sampleResults(const Rectangle& whole, int queryMode, int target, std::vector<std::pair<Point, double>>& out) const {
+    Node* root = nodeMap.at(0);
+    if(root -> rectNums == 0 || !whole.isIntersection(root -> getNodeRectangle())) return;
+    target = std::max(1, target);
+    std::vector<Node*> frontier(1, root);
+    std::vector<Node*> next;
+    double scale = 1.0;
+    while(!frontier[0] -> isLeaf()) {
+        next.clear();
+        for(Node* node : frontier) {
+            for(int i = 0; i < node -> rectNums; i++) {
+                if(whole.isIntersection(node -> data[i])) next.push_back(nodeMap.at(node -> childId[i]));
+            }
+        }
+        if(next.empty()) return;
+        if(next.size() > target) {
+            double step = static_cast<double>(next.size()) / target;
+            for(int i = 0; i < target; i++) {
+                next[i] = next[static_cast<int>((i + 0.5) * step)];
+            }
+            next.resize(target);
+            scale *= step;
+        }
+        frontier.swap(next);
+    }
+
+    for(Node* leaf : frontier) {
+        for(int begin = 0; begin < leaf -> rectNums; begin += MASK_BLOCK) {
+            int count = std::min(MASK_BLOCK, leaf -> rectNums - begin);
+            uint32_t mask = leaf -> data.intersectMask(whole, begin, count);
+            if(queryMode == 0) mask &= leaf -> data.coverMask(whole, begin, count);
+            for(; mask != 0; mask &= mask - 1) {
+                int i = begin + lowestBit(mask);
+                Point reference(std::max(leaf -> data.lowX()[i], whole.low.x), std::max(leaf -> data.lowY()[i], whole.low.y));
+                out.push_back(std::make_pair(reference, scale));
+            }
+        }
+    }
+}
+
 // find the final MBR of the tree
-Rectangle Rtree :: getFinalRect() {
+Rectangle Rtree :: getFinalRect() const {
     return nodeMap.at(0) -> getNodeRectangle();
 }
 
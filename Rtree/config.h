@@ -9,7 +9,15 @@
 #include <limits>
 #include <cmath>
 #include <cassert>
+#include <queue>
 #include <iostream>
+#include <cstdint>
+
+const int NODE_SLAB_SIZE = 256; // nodes per slab in the node arena of a tree
+const int HILBERT_ORDER = 16; // Hilbert curve used by packed loading covers a 2^16 x 2^16 grid
+const double RSTAR_MIN_FILL = 0.4; // R* split: minimum share of entries in each group
+const double RSTAR_REINSERT_FRACTION = 0.3; // R* forced reinsertion: share of entries removed from an overflowing node
+const int QUERY_STACK_SIZE = 512; // pending nodes kept by the iterative range query before it recurses
 
 struct Point {
     int x;
@@ -17,12 +25,12 @@ struct Point {
 
     Point();
     Point(int _x, int _y);
-    int getDist(Point pt);
+    int getDist(Point pt) const;
 
     bool operator == (const Point& other) const {
         return x == other.x && y == other.y;
     }
-    std::string printPoint() {
+    std::string printPoint() const {
         std::string baseStr = "(" + std::to_string(x) + ", " + std::to_string(y) + ")";
         return baseStr;
     }
@@ -37,20 +45,21 @@ struct Rectangle {
     bool operator == (const Rectangle& rect) const {
         return low == rect.low && high == rect.high;
     }
-    bool isIntersection(Rectangle rect);
-    bool cover(Rectangle rect);
-    bool cover(Point pt);
-    bool splitAxis();
-    Rectangle unionRect(Rectangle rect);
-    Rectangle intersectRect(Rectangle rect);
+    bool isIntersection(Rectangle rect) const;
+    bool cover(Rectangle rect) const;
+    bool cover(Point pt) const;
+    bool splitAxis() const;
+    Rectangle unionRect(Rectangle rect) const;
+    Rectangle intersectRect(Rectangle rect) const;
     static Rectangle unionRects(std::vector<Rectangle> rects);
     static Rectangle intersectRects(std::vector<Rectangle> rects);
-    double getArea();
-    double getIntersectionArea(Rectangle rect);
-    double getMinDist(Point pt);
-    double getMaxMinDist(Point pt);
-    Point getMidPoint();
-    std::string printRect();
+    double getArea() const;
+    double getMargin() const;
+    double getIntersectionArea(Rectangle rect) const;
+    double getMinDist(Point pt) const;
+    double getMaxMinDist(Point pt) const;
+    Point getMidPoint() const;
+    std::string printRect() const;
 };
 
 Point :: Point() : x(-1), y(-1) {}
@@ -58,7 +67,7 @@ Point :: Point() : x(-1), y(-1) {}
 Point :: Point(int _x, int _y) : x(_x), y(_y) {}
 
 // distance between two points
-int Point :: getDist(Point pt) {
+int Point :: getDist(Point pt) const {
     return std::pow((this -> x - pt.x), 2) + std::pow((this -> y - pt.y), 2);
 }
 
@@ -74,7 +83,7 @@ Rectangle :: Rectangle(Point ptMin, Point ptMax) {
 }
 
 // union two rectangle into one
-Rectangle Rectangle :: unionRect(Rectangle rect) {
+Rectangle Rectangle :: unionRect(Rectangle rect) const {
     double xMin = std::min(this -> low.x, rect.low.x);
     double yMin = std::min(this -> low.y, rect.low.y);
     double xMax = std::max(this -> high.x, rect.high.x);
@@ -86,7 +95,7 @@ Rectangle Rectangle :: unionRect(Rectangle rect) {
 }
 
 // intersect two rectangle into one
-Rectangle Rectangle :: intersectRect(Rectangle rect) {
+Rectangle Rectangle :: intersectRect(Rectangle rect) const {
     double xMin = std::max(this -> low.x, rect.low.x);
     double yMin = std::max(this -> low.y, rect.low.y);
     double xMax = std::min(this -> high.x, rect.high.x);
@@ -126,12 +135,17 @@ Rectangle Rectangle :: intersectRects(std::vector<Rectangle> rects) {
 }
 
 // the area of a rectangle, used in split of R-Tree
-double Rectangle :: getArea() {
+double Rectangle :: getArea() const {
     return std::abs((this -> high.x - this -> low.x) * (this -> high.y - this -> low.y));
 }
 
+// half perimeter of a rectangle, used in R* split
+double Rectangle :: getMargin() const {
+    return std::abs(this -> high.x - this -> low.x) + std::abs(this -> high.y - this -> low.y);
+}
+
 // return the area of intersection between two rectangles
-double Rectangle :: getIntersectionArea(Rectangle rect) {
+double Rectangle :: getIntersectionArea(Rectangle rect) const {
     if(!isIntersection(rect)) {
         return 0.0;
     }
@@ -147,9 +161,8 @@ double Rectangle :: getIntersectionArea(Rectangle rect) {
     return width * height;
 }
 
-// for test, not used
-// return the minimum distance from the point to the rectangle.
-double Rectangle :: getMinDist(Point pt) {
+// return the squared minimum distance from the point to the rectangle, MINDIST in nearest neighbour search
+double Rectangle :: getMinDist(Point pt) const {
     if(cover(pt)) return 0.0;
     double d1 = 0.0;
     double d2 = 0.0;
@@ -164,9 +177,12 @@ double Rectangle :: getMinDist(Point pt) {
     return std::pow(std::abs(pt.x - d1), 2) + std::pow(std::abs(pt.y - d2), 2);
 }
 
-// for test, not used
-// return the minimum maximum distance from the point to the rectangle.
-double Rectangle :: getMaxMinDist(Point pt) {
+/*
+return the squared minimum maximum distance from the point to the rectangle,
+MINMAXDIST in nearest neighbour search: some object in a tight MBR lies
+within this distance. it is the distance to the second nearest corner
+*/
+double Rectangle :: getMaxMinDist(Point pt) const {
     std::vector<double> dist;
     Point vertice1(low.x, high.y);
     Point vertice2(high.x, low.y);
@@ -179,36 +195,36 @@ double Rectangle :: getMaxMinDist(Point pt) {
     return dist[1]; 
 }
 
-Point Rectangle :: getMidPoint() {
+Point Rectangle :: getMidPoint() const {
     double midX = (this -> low.x + this -> high.x) / 2;
     double midY = (this -> low.y + this -> high.y) / 2;
     return Point(midX, midY);
 }
 
 // if two rectangle intersect
-bool Rectangle :: isIntersection(Rectangle rect) {
+bool Rectangle :: isIntersection(Rectangle rect) const {
     if((this -> low.x > rect.high.x || this -> high.x < rect.low.x) || 
        (this -> low.y > rect.high.y || this -> high.y < rect.low.y)) return false;
     return true;
 }
 
 // if the invoker rectangle cover the parameter rectangle
-bool Rectangle :: cover(Rectangle rect) {
+bool Rectangle :: cover(Rectangle rect) const {
     return (low.x <= rect.low.x && low.y <= rect.low.y &&
             high.x >= rect.high.x && high.y >= rect.high.y);
 }
 
 // if the invoker rectangle contain the parameter point
-bool Rectangle :: cover(Point pt) {
+bool Rectangle :: cover(Point pt) const {
     return (low.x <= pt.x && low.y <= pt.y && high.x >= pt.x && high.y >= pt.y);
 }
 
 // return true - split by x; false - split by y
-bool Rectangle :: splitAxis() {
+bool Rectangle :: splitAxis() const {
     return this -> high.x - this -> low.x > this -> high.y - this -> low.y;
 }
 
-std::string Rectangle :: printRect() {
+std::string Rectangle :: printRect() const {
     std::string baseStr = "";
     baseStr = baseStr + low.printPoint() + " - " + high.printPoint() + "\n";
     return baseStr;
@@ -0,0 +1,263 @@
+#ifndef MY_NODE_ENTRIES
+#define MY_NODE_ENTRIES
+
+#include "./config.h"
+#include <stdexcept>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RTREE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+const int ENTRY_LANES = 8; // arrays are padded to a multiple of the widest vector (8 x int32)
+const int MASK_BLOCK = 32; // entries tested by one kernel call, one bit each
+
+/*
+kernels testing a query against a block of up to MASK_BLOCK entries stored as
+separate coordinate arrays. bit i of the result is set when entry i passes.
+coverMask - the query covers the entry, intersectMask - they intersect
+*/
+typedef uint32_t (*MaskKernel)(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                               int count, const Rectangle& query);
+
+struct EntryKernels {
+    MaskKernel coverMask;
+    MaskKernel intersectMask;
+    const char* name;
+};
+
+uint32_t coverMaskScalar(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                         int count, const Rectangle& query) {
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i++) {
+        bool covered = query.low.x <= lowX[i] && query.low.y <= lowY[i] &&
+                       query.high.x >= highX[i] && query.high.y >= highY[i];
+        mask |= static_cast<uint32_t>(covered) << i;
+    }
+    return mask;
+}
+
+uint32_t intersectMaskScalar(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                             int count, const Rectangle& query) {
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i++) {
+        bool apart = query.low.x > highX[i] || query.high.x < lowX[i] ||
+                     query.low.y > highY[i] || query.high.y < lowY[i];
+        mask |= static_cast<uint32_t>(!apart) << i;
+    }
+    return mask;
+}
+
+#ifdef RTREE_X86_KERNELS
+
+// SSE2 is part of every x86-64 cpu, 4 entries per step
+uint32_t coverMaskSSE(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                      int count, const Rectangle& query) {
+    __m128i qlx = _mm_set1_epi32(query.low.x), qly = _mm_set1_epi32(query.low.y);
+    __m128i qhx = _mm_set1_epi32(query.high.x), qhy = _mm_set1_epi32(query.high.y);
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i += 4) {
+        __m128i miss = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(qlx, _mm_loadu_si128((const __m128i*)(lowX + i))),
+                         _mm_cmpgt_epi32(qly, _mm_loadu_si128((const __m128i*)(lowY + i)))),
+            _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(highX + i)), qhx),
+                         _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(highY + i)), qhy)));
+        uint32_t bits = ~_mm_movemask_ps(_mm_castsi128_ps(miss)) & 0xF;
+        mask |= bits << i;
+    }
+    return count < MASK_BLOCK ? mask & ((1u << count) - 1) : mask;
+}
+
+uint32_t intersectMaskSSE(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                          int count, const Rectangle& query) {
+    __m128i qlx = _mm_set1_epi32(query.low.x), qly = _mm_set1_epi32(query.low.y);
+    __m128i qhx = _mm_set1_epi32(query.high.x), qhy = _mm_set1_epi32(query.high.y);
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i += 4) {
+        __m128i apart = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(qlx, _mm_loadu_si128((const __m128i*)(highX + i))),
+                         _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(lowX + i)), qhx)),
+            _mm_or_si128(_mm_cmpgt_epi32(qly, _mm_loadu_si128((const __m128i*)(highY + i))),
+                         _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(lowY + i)), qhy)));
+        uint32_t bits = ~_mm_movemask_ps(_mm_castsi128_ps(apart)) & 0xF;
+        mask |= bits << i;
+    }
+    return count < MASK_BLOCK ? mask & ((1u << count) - 1) : mask;
+}
+
+// 8 entries per step, only used when the cpu reports AVX2
+__attribute__((target("avx2")))
+uint32_t coverMaskAVX2(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                       int count, const Rectangle& query) {
+    __m256i qlx = _mm256_set1_epi32(query.low.x), qly = _mm256_set1_epi32(query.low.y);
+    __m256i qhx = _mm256_set1_epi32(query.high.x), qhy = _mm256_set1_epi32(query.high.y);
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i += 8) {
+        __m256i miss = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(qlx, _mm256_loadu_si256((const __m256i*)(lowX + i))),
+                            _mm256_cmpgt_epi32(qly, _mm256_loadu_si256((const __m256i*)(lowY + i)))),
+            _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(highX + i)), qhx),
+                            _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(highY + i)), qhy)));
+        uint32_t bits = ~_mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xFF;
+        mask |= bits << i;
+    }
+    return count < MASK_BLOCK ? mask & ((1u << count) - 1) : mask;
+}
+
+__attribute__((target("avx2")))
+uint32_t intersectMaskAVX2(const int* lowX, const int* lowY, const int* highX, const int* highY,
+                           int count, const Rectangle& query) {
+    __m256i qlx = _mm256_set1_epi32(query.low.x), qly = _mm256_set1_epi32(query.low.y);
+    __m256i qhx = _mm256_set1_epi32(query.high.x), qhy = _mm256_set1_epi32(query.high.y);
+    uint32_t mask = 0;
+    for(int i = 0; i < count; i += 8) {
+        __m256i apart = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(qlx, _mm256_loadu_si256((const __m256i*)(highX + i))),
+                            _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(lowX + i)), qhx)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(qly, _mm256_loadu_si256((const __m256i*)(highY + i))),
+                            _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(lowY + i)), qhy)));
+        uint32_t bits = ~_mm256_movemask_ps(_mm256_castsi256_ps(apart)) & 0xFF;
+        mask |= bits << i;
+    }
+    return count < MASK_BLOCK ? mask & ((1u << count) - 1) : mask;
+}
+
+#endif
+
+// pick the widest kernels the running cpu supports, decided once
+const EntryKernels& entryKernels() {
+    static const EntryKernels kernels = []() {
+#ifdef RTREE_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) return EntryKernels{coverMaskAVX2, intersectMaskAVX2, "avx2"};
+        return EntryKernels{coverMaskSSE, intersectMaskSSE, "sse2"};
+#else
+        return EntryKernels{coverMaskScalar, intersectMaskScalar, "scalar"};
+#endif
+    }();
+    return kernels;
+}
+
+// index of the lowest set bit, mask must not be 0
+inline int lowestBit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while(!(mask & 1u)) {
+        mask >>= 1;
+        i += 1;
+    }
+    return i;
+#endif
+}
+
+/*
+entries of a node kept as structure of arrays: lowX, lowY, highX and highY of
+all entries lie in four contiguous arrays, padded to ENTRY_LANES, so that a
+whole node is tested against a query by a few vector instructions
+*/
+class EntryArray {
+public:
+    EntryArray();
+    void assign(int count, Rectangle rect);
+    void push_back(Rectangle rect);
+    void set(int index, Rectangle rect);
+    const Rectangle operator [] (int index) const;
+    const Rectangle at(int index) const;
+    int size() const;
+    Rectangle bound(int count) const;
+    uint32_t coverMask(const Rectangle& query, int begin, int count) const;
+    uint32_t intersectMask(const Rectangle& query, int begin, int count) const;
+    const int* lowX() const;
+    const int* lowY() const;
+    const int* highX() const;
+    const int* highY() const;
+
+private:
+    int count; // number of entries
+    int stride; // padded length of each coordinate array
+    std::vector<int> coords; // lowX | lowY | highX | highY, each stride long
+    void reserve(int capacity);
+};
+
+EntryArray :: EntryArray() : count(0), stride(0) {}
+
+// reset to count copies of rect, room for one extra entry is kept for splits
+void EntryArray :: assign(int _count, Rectangle rect) {
+    count = 0;
+    stride = 0;
+    coords.clear();
+    reserve(_count + 1);
+    for(int i = 0; i < _count; i++) {
+        push_back(rect);
+    }
+}
+
+void EntryArray :: push_back(Rectangle rect) {
+    if(count == stride) reserve(count + 1);
+    count += 1;
+    set(count - 1, rect);
+}
+
+void EntryArray :: set(int index, Rectangle rect) {
+    coords[index] = rect.low.x;
+    coords[stride + index] = rect.low.y;
+    coords[2 * stride + index] = rect.high.x;
+    coords[3 * stride + index] = rect.high.y;
+}
+
+const Rectangle EntryArray :: operator [] (int index) const {
+    return Rectangle(Point(coords[index], coords[stride + index]),
+                     Point(coords[2 * stride + index], coords[3 * stride + index]));
+}
+
+const Rectangle EntryArray :: at(int index) const {
+    if(index < 0 || index >= count) throw std::out_of_range("EntryArray : index out of range");
+    return (*this)[index];
+}
+
+int EntryArray :: size() const {
+    return count;
+}
+
+// MBR of the first count entries
+Rectangle EntryArray :: bound(int _count) const {
+    Rectangle result = (*this)[0];
+    for(int i = 1; i < _count; i++) {
+        result.low.x = std::min(result.low.x, coords[i]);
+        result.low.y = std::min(result.low.y, coords[stride + i]);
+        result.high.x = std::max(result.high.x, coords[2 * stride + i]);
+        result.high.y = std::max(result.high.y, coords[3 * stride + i]);
+    }
+    return result;
+}
+
+// bit i set when query covers entry begin + i, count is at most MASK_BLOCK
+uint32_t EntryArray :: coverMask(const Rectangle& query, int begin, int _count) const {
+    return entryKernels().coverMask(lowX() + begin, lowY() + begin, highX() + begin, highY() + begin, _count, query);
+}
+
+// bit i set when query intersects entry begin + i, count is at most MASK_BLOCK
+uint32_t EntryArray :: intersectMask(const Rectangle& query, int begin, int _count) const {
+    return entryKernels().intersectMask(lowX() + begin, lowY() + begin, highX() + begin, highY() + begin, _count, query);
+}
+
+const int* EntryArray :: lowX() const { return coords.data(); }
+const int* EntryArray :: lowY() const { return coords.data() + stride; }
+const int* EntryArray :: highX() const { return coords.data() + 2 * stride; }
+const int* EntryArray :: highY() const { return coords.data() + 3 * stride; }
+
+// grow every coordinate array to hold capacity entries, rounded up to ENTRY_LANES
+void EntryArray :: reserve(int capacity) {
+    int padded = (capacity + ENTRY_LANES - 1) / ENTRY_LANES * ENTRY_LANES;
+    if(padded <= stride) return;
+    std::vector<int> grown(4 * padded, 0);
+    for(int a = 0; a < 4; a++) {
+        std::copy(coords.begin() + a * stride, coords.begin() + a * stride + count, grown.begin() + a * padded);
+    }
+    coords.swap(grown);
+    stride = padded;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef MY_NODE_POOL
+#define MY_NODE_POOL
+
+#include "./config.h"
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+/*
+arena of the nodes in one R-Tree. nodes are constructed inside fixed size slabs
+and addressed by their pageId through a dense index, so finding a node is one
+array access, and releasing the tree releases the slabs as a whole.
+*/
+template <typename T>
+class NodePool {
+public:
+    NodePool();
+    NodePool(const NodePool& other) = delete;
+    NodePool(NodePool&& other) noexcept;
+    NodePool& operator = (const NodePool& other) = delete;
+    NodePool& operator = (NodePool&& other) noexcept;
+    ~NodePool();
+
+    template <typename... Args>
+    T* create(Args&&... args);
+    void insert_or_assign(int pageId, T* node);
+    T* at(int pageId) const;
+    T* operator [] (int pageId) const;
+    int pageCount() const;
+    void reclaim();
+    void clear();
+
+private:
+    std::vector<T*> slabs; // every slab holds NODE_SLAB_SIZE nodes
+    int slabUsed; // constructed nodes in the last slab
+    std::vector<T*> index; // pageId -> node, nullptr for unused pages
+    std::vector<T*> retired; // nodes replaced during the current insertion
+    std::vector<T*> freeSlots; // constructed nodes ready to be reused
+};
+
+template <typename T>
+NodePool<T> :: NodePool() : slabUsed(NODE_SLAB_SIZE) {}
+
+template <typename T>
+NodePool<T> :: NodePool(NodePool&& other) noexcept : slabs(std::move(other.slabs)), slabUsed(other.slabUsed),
+                                                     index(std::move(other.index)), retired(std::move(other.retired)),
+                                                     freeSlots(std::move(other.freeSlots)) {
+    other.slabs.clear();
+    other.slabUsed = NODE_SLAB_SIZE;
+}
+
+template <typename T>
+NodePool<T>& NodePool<T> :: operator = (NodePool&& other) noexcept {
+    if(this != &other) {
+        clear();
+        slabs = std::move(other.slabs);
+        slabUsed = other.slabUsed;
+        index = std::move(other.index);
+        retired = std::move(other.retired);
+        freeSlots = std::move(other.freeSlots);
+        other.slabs.clear();
+        other.slabUsed = NODE_SLAB_SIZE;
+    }
+    return *this;
+}
+
+template <typename T>
+NodePool<T> :: ~NodePool() {
+    clear();
+}
+
+// construct a node in the arena, slots of replaced nodes are reused first
+template <typename T>
+template <typename... Args>
+T* NodePool<T> :: create(Args&&... args) {
+    if(!freeSlots.empty()) {
+        T* node = freeSlots.back();
+        freeSlots.pop_back();
+        *node = T(std::forward<Args>(args)...);
+        return node;
+    }
+    if(slabUsed == NODE_SLAB_SIZE) {
+        slabs.push_back(static_cast<T*>(::operator new(sizeof(T) * NODE_SLAB_SIZE)));
+        slabUsed = 0;
+    }
+    T* node = new (slabs.back() + slabUsed) T(std::forward<Args>(args)...);
+    slabUsed += 1;
+    return node;
+}
+
+/*
+bind a node to a page, the node previously stored on that page is retired.
+retired nodes may still be referenced by the running insertion, so they
+are only reused after reclaim()
+*/
+template <typename T>
+void NodePool<T> :: insert_or_assign(int pageId, T* node) {
+    if(pageId >= static_cast<int>(index.size())) {
+        index.resize(std::max<size_t>(pageId + 1, index.size() * 2), nullptr);
+    }
+    T* previous = index[pageId];
+    if(previous != nullptr && previous != node) {
+        retired.push_back(previous);
+    }
+    index[pageId] = node;
+}
+
+// return the node stored on the page, throw if the page was never used
+template <typename T>
+T* NodePool<T> :: at(int pageId) const {
+    T* node = index.at(pageId);
+    if(node == nullptr) throw std::out_of_range("NodePool : page not allocated");
+    return node;
+}
+
+template <typename T>
+T* NodePool<T> :: operator [] (int pageId) const {
+    return index[pageId];
+}
+
+// number of page slots in the index, live nodes are those not nullptr
+template <typename T>
+int NodePool<T> :: pageCount() const {
+    return index.size();
+}
+
+// hand the slots of retired nodes back to the arena
+template <typename T>
+void NodePool<T> :: reclaim() {
+    freeSlots.insert(freeSlots.end(), retired.begin(), retired.end());
+    retired.clear();
+}
+
+// destroy every node and release all slabs
+template <typename T>
+void NodePool<T> :: clear() {
+    for(size_t i = 0; i < slabs.size(); i++) {
+        int constructed = (i + 1 == slabs.size()) ? slabUsed : NODE_SLAB_SIZE;
+        for(int j = 0; j < constructed; j++) {
+            slabs[i][j].~T();
+        }
+        ::operator delete(slabs[i]);
+    }
+    slabs.clear();
+    slabUsed = NODE_SLAB_SIZE;
+    index.clear();
+    retired.clear();
+    freeSlots.clear();
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef MY_SPATIAL_JOIN
+#define MY_SPATIAL_JOIN
+
+#include "./RTree.h"
+
+// indices of the entries of a node that intersect window
+void entriesIntersecting(Node* node, const Rectangle& window, std::vector<int>& out) {
+    out.clear();
+    for(int begin = 0; begin < node -> rectNums; begin += MASK_BLOCK) {
+        int count = std::min(MASK_BLOCK, node -> rectNums - begin);
+        uint32_t mask = node -> data.intersectMask(window, begin, count);
+        while(mask != 0) {
+            out.push_back(begin + lowestBit(mask));
+            mask &= mask - 1;
+        }
+    }
+}
+
+/*
+join two nodes. when their levels differ, the higher node is descended alone
+into the children that reach the other node's MBR. on the same level, only
+entries inside the intersection of both MBRs take part, and they are paired
+by a plane sweep along x: both lists are sorted by low.x and every entry is
+only compared with the entries of the other list starting inside its x range
+*/
+template <typename Callback>
+void joinNodes(Node* a, Node* b, Callback& callback) {
+    std::vector<int> entriesA;
+    std::vector<int> entriesB;
+    if(a -> level > b -> level) {
+        entriesIntersecting(a, b -> getNodeRectangle(), entriesA);
+        for(int i : entriesA) {
+            joinNodes(a -> getChild(i), b, callback);
+        }
+        return;
+    }
+    if(b -> level > a -> level) {
+        entriesIntersecting(b, a -> getNodeRectangle(), entriesB);
+        for(int j : entriesB) {
+            joinNodes(a, b -> getChild(j), callback);
+        }
+        return;
+    }
+
+    Rectangle rectA = a -> getNodeRectangle();
+    Rectangle rectB = b -> getNodeRectangle();
+    if(!rectA.isIntersection(rectB)) return;
+    Rectangle window = rectA.intersectRect(rectB);
+    entriesIntersecting(a, window, entriesA);
+    entriesIntersecting(b, window, entriesB);
+
+    const int* lowXA = a -> data.lowX();
+    const int* lowXB = b -> data.lowX();
+    std::sort(entriesA.begin(), entriesA.end(), [lowXA](int i, int j) { return lowXA[i] < lowXA[j]; });
+    std::sort(entriesB.begin(), entriesB.end(), [lowXB](int i, int j) { return lowXB[i] < lowXB[j]; });
+
+    auto emit = [&](int i, int j) {
+        if(a -> isLeaf()) callback(a -> data[i], b -> data[j]);
+        else joinNodes(a -> getChild(i), b -> getChild(j), callback);
+    };
+
+    size_t i = 0, j = 0;
+    while(i < entriesA.size() && j < entriesB.size()) {
+        if(lowXA[entriesA[i]] <= lowXB[entriesB[j]]) {
+            Rectangle entry = a -> data[entriesA[i]];
+            for(size_t k = j; k < entriesB.size() && lowXB[entriesB[k]] <= entry.high.x; k++) {
+                Rectangle other = b -> data[entriesB[k]];
+                if(entry.low.y <= other.high.y && other.low.y <= entry.high.y) emit(entriesA[i], entriesB[k]);
+            }
+            i += 1;
+        } else {
+            Rectangle entry = b -> data[entriesB[j]];
+            for(size_t k = i; k < entriesA.size() && lowXA[entriesA[k]] <= entry.high.x; k++) {
+                Rectangle other = a -> data[entriesA[k]];
+                if(entry.low.y <= other.high.y && other.low.y <= entry.high.y) emit(entriesA[k], entriesB[j]);
+            }
+            j += 1;
+        }
+    }
+}
+
+/*
+spatial join by synchronized traversal: both trees are descended together and
+only pairs of entries whose MBRs intersect are followed. callback(rectA, rectB)
+is called exactly once for every pair of intersecting rectangles, rectA from
+tree a and rectB from tree b
+*/
+template <typename Callback>
+void spatialJoin(const Rtree& a, const Rtree& b, Callback&& callback) {
+    Node* rootA = a.getRoot();
+    Node* rootB = b.getRoot();
+    if(rootA -> rectNums == 0 || rootB -> rectNums == 0) return;
+    joinNodes(rootA, rootB, callback);
+}
+
+#endif
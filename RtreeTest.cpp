@@ -3,34 +3,251 @@
 #include <chrono>
 #include "Rtree/RTree.h"
 #include "MapReduce/master.h"
+#include "MapReduce/queries.h"
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <tuple>
+#include <iterator>
 
-std::vector<Rtree> dataGenerator(int dataSize, int subSize) {
+std::vector<Rtree> dataGenerator(int dataSize, int subSize, int maxSide = 10000) {
     std::vector<Rtree> dataset;
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
     for(int i = 0; i < dataSize; i++) {
         std::vector<std::vector<double>> pointSubSet(subSize, std::vector<double>(4));
         for(int j = 0; j < subSize; j++) {
             for(int k = 0; k < 4; k++) {
-                pointSubSet[j][k] = static_cast<double>(std::rand() % 10001);
+                pointSubSet[j][k] = static_cast<double>(std::rand() % ((k < 2 ? 10000 : maxSide) + 1));
             }
         }
-        Rtree *tree = new Rtree();
-        tree -> initite(-1, 0, 0, 10, 0);
+        Rtree tree;
+        tree.initite(-1, 0, 0, 10, 0);
 
         for(int l = 0; l < pointSubSet.size(); l++) {
             Point pt1(pointSubSet[l][0], pointSubSet[l][1]);
             Point pt2(pointSubSet[l][0] + pointSubSet[l][2], pointSubSet[l][1] + pointSubSet[l][3]);
             Rectangle rect(pt1, pt2);
-            tree -> insertNode(rect, -2);
+            tree.insertNode(rect, -2);
         }
-        dataset.emplace_back(*tree);
+        dataset.push_back(std::move(tree));
     }
     return dataset;
 }
 
+// random rectangles with lower left corners in [0, 10000] and sides up to maxSide
+std::vector<Rectangle> rectGenerator(int count, int maxSide) {
+    std::vector<Rectangle> rects;
+    for(int i = 0; i < count; i++) {
+        Point low(std::rand() % 10001, std::rand() % 10001);
+        rects.push_back(Rectangle(low, Point(low.x + std::rand() % (maxSide + 1), low.y + std::rand() % (maxSide + 1))));
+    }
+    return rects;
+}
+
+// if two result lists hold the same rectangles, in any order
+bool sameRects(std::vector<Rectangle> a, std::vector<Rectangle> b) {
+    auto less = [](const Rectangle& r1, const Rectangle& r2) {
+        return std::make_tuple(r1.low.x, r1.low.y, r1.high.x, r1.high.y) < std::make_tuple(r2.low.x, r2.low.y, r2.high.x, r2.high.y);
+    };
+    std::sort(a.begin(), a.end(), less);
+    std::sort(b.begin(), b.end(), less);
+    return a == b;
+}
+
+// range queries on the tree against a scan over rects, both covered and intersecting rectangles
+bool checkRange(const Rtree& tree, const std::vector<Rectangle>& rects, int queryNum) {
+    for(const Rectangle& query : rectGenerator(queryNum, 3000)) {
+        std::vector<Rectangle> covered;
+        std::vector<Rectangle> intersecting;
+        for(const Rectangle& rect : rects) {
+            if(query.cover(rect)) covered.push_back(rect);
+            if(query.isIntersection(rect)) intersecting.push_back(rect);
+        }
+        std::vector<Rectangle> found;
+        tree.queryInto(query, std::back_inserter(found));
+        if(!sameRects(found, covered)) return false;
+        found.clear();
+        bool idsMatch = true;
+        tree.queryEntries(query, [&](const Rectangle& rect, int id) {
+            found.push_back(rect);
+            idsMatch = idsMatch && id >= 0 && id < static_cast<int>(rects.size()) && rects[id] == rect;
+        });
+        if(!idsMatch || !sameRects(found, intersecting)) return false;
+    }
+    return true;
+}
+
+// bulk load a tree by packMode and query it against the input
+bool checkBulkLoad(int packMode) {
+    std::vector<Rectangle> rects = rectGenerator(3000, 200);
+    Rtree tree;
+    tree.bulkLoad(rects, 0.7, packMode);
+    if(packMode == 1) {
+        // the curve order lists every input position once
+        std::vector<int> order = tree.hilbertOrder;
+        std::sort(order.begin(), order.end());
+        if(order.size() != rects.size()) return false;
+        for(int i = 0; i < static_cast<int>(order.size()); i++) {
+            if(order[i] != i) return false;
+        }
+    }
+    return checkRange(tree, rects, 50);
+}
+
+// insert one by one by splitMode, so R* splits and reinserts on overflow, and query the tree against the input
+bool checkInsert(int splitMode) {
+    std::vector<Rectangle> rects = rectGenerator(3000, 200);
+    Rtree tree;
+    tree.initite(-1, 0, 0, 10, splitMode);
+    for(int i = 0; i < static_cast<int>(rects.size()); i++) {
+        tree.insertNode(rects[i], i);
+    }
+    return checkRange(tree, rects, 50);
+}
+
+// one vector kernel against the scalar one on random blocks, small coordinates so that edges often touch
+bool checkKernel(MaskKernel kernel, MaskKernel scalar) {
+    int lowX[MASK_BLOCK], lowY[MASK_BLOCK], highX[MASK_BLOCK], highY[MASK_BLOCK];
+    for(int round = 0; round < 2000; round++) {
+        for(int i = 0; i < MASK_BLOCK; i++) {
+            lowX[i] = std::rand() % 50;
+            lowY[i] = std::rand() % 50;
+            highX[i] = lowX[i] + std::rand() % 20;
+            highY[i] = lowY[i] + std::rand() % 20;
+        }
+        Point low(std::rand() % 50, std::rand() % 50);
+        Rectangle query(low, Point(low.x + std::rand() % 40, low.y + std::rand() % 40));
+        int count = 1 + round % MASK_BLOCK;
+        if(kernel(lowX, lowY, highX, highY, count, query) != scalar(lowX, lowY, highX, highY, count, query)) return false;
+    }
+    return true;
+}
+
+// the kernels picked for this cpu and every narrower one against the scalar kernels, then Node::queryRect against a scan
+bool checkKernels() {
+    const EntryKernels& kernels = entryKernels();
+    bool passed = checkKernel(kernels.coverMask, coverMaskScalar) && checkKernel(kernels.intersectMask, intersectMaskScalar);
+#ifdef RTREE_X86_KERNELS
+    passed = passed && checkKernel(coverMaskSSE, coverMaskScalar) && checkKernel(intersectMaskSSE, intersectMaskScalar);
+#endif
+    std::vector<Rectangle> rects = rectGenerator(3000, 200);
+    Rtree tree;
+    tree.bulkLoad(rects);
+    for(const Rectangle& query : rectGenerator(50, 3000)) {
+        std::vector<Rectangle> covered;
+        for(const Rectangle& rect : rects) {
+            if(query.cover(rect)) covered.push_back(rect);
+        }
+        passed = passed && sameRects(tree.getRoot() -> queryRect(query), covered);
+    }
+    return passed;
+}
+
+// the visitor query, and the same query started below every child of the root, against a scan
+bool checkVisitor() {
+    std::vector<Rectangle> rects = rectGenerator(3000, 200);
+    Rtree tree;
+    tree.initite(-1, 0, 0, 10, 0);
+    for(const Rectangle& rect : rects) {
+        tree.insertNode(rect, -2);
+    }
+    Node* root = tree.getRoot();
+    for(const Rectangle& query : rectGenerator(50, 3000)) {
+        std::vector<Rectangle> covered;
+        for(const Rectangle& rect : rects) {
+            if(query.cover(rect)) covered.push_back(rect);
+        }
+        std::vector<Rectangle> visited;
+        tree.query(query, [&visited](const Rectangle& hit) {
+            visited.push_back(hit);
+        });
+        std::vector<Rectangle> below;
+        for(int i = 0; i < root -> rectNums; i++) {
+            tree.queryFrom(root -> getChild(i), query, [&below](const Rectangle& hit) {
+                below.push_back(hit);
+            });
+        }
+        if(!sameRects(visited, covered) || !sameRects(below, covered)) return false;
+    }
+    return true;
+}
+
+// k nearest neighbours against the distances of all rectangles sorted, ties may pick either rectangle
+bool checkNearest(int count, int k) {
+    std::vector<Rectangle> rects = rectGenerator(count, 200);
+    Rtree tree;
+    tree.bulkLoad(rects);
+    for(int round = 0; round < 50; round++) {
+        Point pt(std::rand() % 12001 - 1000, std::rand() % 12001 - 1000);
+        std::vector<double> dists;
+        for(const Rectangle& rect : rects) {
+            dists.push_back(std::sqrt(rect.getMinDist(pt)));
+        }
+        std::sort(dists.begin(), dists.end());
+        std::vector<std::pair<Rectangle, double>> found = tree.nearest(pt, k);
+        if(found.size() != std::min<size_t>(k, rects.size())) return false;
+        for(size_t i = 0; i < found.size(); i++) {
+            if(found[i].second != dists[i] || found[i].second != std::sqrt(found[i].first.getMinDist(pt))) return false;
+            if(std::find(rects.begin(), rects.end(), found[i].first) == rects.end()) return false;
+        }
+    }
+    return true;
+}
+
+// spatial join of trees with different heights against a scan over all pairs
+bool checkJoin() {
+    std::vector<Rectangle> rectsA = rectGenerator(2000, 300);
+    std::vector<Rectangle> rectsB = rectGenerator(200, 300);
+    Rtree treeA;
+    treeA.initite(-1, 0, 0, 10, 2);
+    for(const Rectangle& rect : rectsA) {
+        treeA.insertNode(rect, -2);
+    }
+    Rtree treeB;
+    treeB.bulkLoad(rectsB);
+
+    typedef std::tuple<int, int, int, int, int, int, int, int> Pair;
+    auto key = [](const Rectangle& a, const Rectangle& b) {
+        return Pair(a.low.x, a.low.y, a.high.x, a.high.y, b.low.x, b.low.y, b.high.x, b.high.y);
+    };
+    std::vector<Pair> expected;
+    for(const Rectangle& a : rectsA) {
+        for(const Rectangle& b : rectsB) {
+            if(a.isIntersection(b)) expected.push_back(key(a, b));
+        }
+    }
+    std::vector<Pair> found;
+    spatialJoin(treeA, treeB, [&](const Rectangle& a, const Rectangle& b) {
+        found.push_back(key(a, b));
+    });
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    return found == expected;
+}
+
+// a batch of queries, some of them repeated, against the same queries answered one by one
+bool checkBatch() {
+    std::vector<Rectangle> rects = rectGenerator(3000, 200);
+    Rtree tree;
+    tree.bulkLoad(rects, 1.0, 1);
+    std::vector<Rectangle> queries = rectGenerator(100, 3000);
+    queries.push_back(queries.front());
+    std::vector<std::vector<Rectangle>> batch = tree.queryBatch(queries);
+    if(batch.size() != queries.size()) return false;
+    for(size_t i = 0; i < queries.size(); i++) {
+        std::vector<Rectangle> single;
+        tree.queryInto(queries[i], std::back_inserter(single));
+        if(!sameRects(batch[i], single)) return false;
+    }
+    return true;
+}
+
+// print the outcome of one brute-force check
+bool report(const std::string& name, bool passed) {
+    std::cout << name << ": " << (passed ? "passed" : "failed") << "\n";
+    return passed;
+}
+
 int main() {
 
     const int treeNum = 10; // number of R-Trees
@@ -44,7 +261,8 @@ int main() {
     const int queryMaxY = 10000;
 
     auto start = std::chrono::high_resolution_clock::now();
-    std::vector<Rtree> dataset = dataGenerator(treeNum, insertNum);
+    // registered once, the jobs below share the trees through the handle
+    ForestHandle dataset = std::make_shared<Forest>(dataGenerator(treeNum, insertNum));
     auto build_end = std::chrono::high_resolution_clock::now();
 
     Rectangle myQuery(Point(queryMinX, queryMinY), Point(queryMaxX, queryMaxY));
@@ -72,5 +290,60 @@ int main() {
 
     std::cout << result_toStr << std::endl;
     std::cout << time << std::endl;
+    std::cout << "====== Partition Cost ======\n" << master.printCost() << std::endl;
+
+    // count of the answers in every tree, only partial counts cross the shuffle
+    std::map<int, Summary> counts = master.aggregate(myJob, workerNum, Combiner(0));
+    std::string count_toStr = "====== Count by Tree ======\n";
+    for(const auto& count : counts) {
+        count_toStr = count_toStr + "Tree " + std::to_string(count.first) + " : " + std::to_string(count.second.count) + "\n";
+    }
+    std::cout << count_toStr << std::endl;
+
+    // the same pool answers other query types written as generic jobs
+    auto nearest = nearestJob(dataset, Point(queryMaxX, queryMaxY / 2), 3);
+    std::vector<std::pair<Rectangle, double>> neighbours = master.execute(nearest)[0];
+    std::string nearest_toStr = "====== Nearest Neighbours ======\n";
+    for(int i = 0; i < neighbours.size(); i++) {
+        nearest_toStr = nearest_toStr + "Neighbour " + std::to_string(i) + " : " + std::to_string(neighbours[i].second) +
+                        " " + neighbours[i].first.printRect();
+    }
+    std::cout << nearest_toStr << std::endl;
+
+    // the tree operations against brute-force scans over the same rectangles
+    std::cout << "====== Brute-force Checks ======\n";
+    bool passed = true;
+    passed = report("STR bulk load", checkBulkLoad(0)) && passed;
+    passed = report("Hilbert bulk load", checkBulkLoad(1)) && passed;
+    passed = report("R* insertion", checkInsert(2)) && passed;
+    passed = report(std::string("Entry kernels (") + entryKernels().name + ")", checkKernels()) && passed;
+    passed = report("Visitor query", checkVisitor()) && passed;
+    passed = report("Nearest neighbours", checkNearest(3000, 10) && checkNearest(30, 40)) && passed;
+    passed = report("Spatial join", checkJoin()) && passed;
+    passed = report("Batch query", checkBatch()) && passed;
+    std::cout << std::endl;
+    if(!passed) {
+        std::cout << "Brute-force check failed" << std::endl;
+        return 1;
+    }
+
+    // on uniform data the work predicted for every worker stays close to the hits it finds
+    const double costTolerance = 0.25; // largest gap allowed, as a share of the mean work of a worker
+    Job uniformJob(myQuery, dataGenerator(treeNum, 2000, 100));
+    master.excutor(uniformJob, workerNum);
+    double totalCost = 0.0;
+    for(int cost : master.actualCost) {
+        totalCost += cost;
+    }
+    double worstGap = 0.0;
+    for(int i = 0; i < workerNum && totalCost > 0.0; i++) {
+        worstGap = std::max(worstGap, std::abs(master.predictedCost[i] - master.actualCost[i]) / (totalCost / workerNum));
+    }
+    std::cout << "====== Partition Check ======\n" << master.printCost();
+    std::cout << "Largest Gap: " << std::to_string(worstGap * 100) << "% of the mean\n" << std::endl;
+    if(worstGap > costTolerance) {
+        std::cout << "Partition check failed" << std::endl;
+        return 1;
+    }
     return 0;
 }
\ No newline at end of file
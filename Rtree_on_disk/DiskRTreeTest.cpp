@@ -4,6 +4,9 @@
 #include <sstream>
 #include <cstdlib>
 #include <ctime>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
 #include "Rtree_on_disk/Rtree.h"
 // #include "MapReduce/master.h"
 
@@ -21,7 +24,7 @@ void readFileToTree(const std::string& filePath) {
         fh = fm.createFile(fileName.c_str()); 
     }
 
-    RTree rt = RTree(10, fh);
+    RTree rt = RTree(10, fh, WRITE_BACK);
 
     std::ifstream inFile(filePath); // 打开文件
     if (!inFile) {
@@ -44,6 +47,236 @@ void readFileToTree(const std::string& filePath) {
     inFile.close(); // 关闭文件
 }
 
+// count rectangles {x1, x2, y1, y2} with sides up to maxSide
+std::vector<std::vector<int>> rectGenerator(int count, int maxSide) {
+    std::vector<std::vector<int>> rects;
+    for (int i = 0; i < count; i++) {
+        int x = std::rand() % 10001;
+        int y = std::rand() % 10001;
+        rects.push_back({x, x + std::rand() % (maxSide + 1), y, y + std::rand() % (maxSide + 1)});
+    }
+    return rects;
+}
+
+// a file for one check in $TMPDIR, or /tmp, replacing an old one of the same name
+FileHandler createScratch(FileManager& fm, std::string& fileName, const std::string& name) {
+    const char* dir = std::getenv("TMPDIR");
+    fileName = std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp") + "/rtree." + name + "." + std::to_string(getpid());
+    std::remove(fileName.c_str());
+    return fm.createFile(fileName.c_str());
+}
+
+// if one of rects contains p, by a scan
+bool scanSearch(RTree& rt, const std::vector<std::vector<int>>& rects, const std::vector<int>& p) {
+    for (const std::vector<int>& rect : rects) {
+        if (rt.contains(p, rect)) return true;
+    }
+    return false;
+}
+
+// the search RTree::search did before it went level by level, one node at a time
+bool searchDepthFirst(RTree& rt, const std::vector<int>& p, int nodeid, FileHandler& fh) {
+    Node n = rt.diskRead(nodeid, fh);
+    for (int i = 0; i < n.size; i++) {
+        if (!rt.contains(p, n.childMBR[i])) continue;
+        if (n.leaf || searchDepthFirst(rt, p, n.childptr[i], fh)) return true;
+    }
+    return false;
+}
+
+// level by level and depth first search against a scan, on large rectangles whose MBRs overlap
+bool checkSearch(int asyncBackend) {
+    FileManager fm(16, LRU_POLICY, asyncBackend);
+    std::string fileName;
+    FileHandler fh = createScratch(fm, fileName, "search");
+    RTree rt = RTree(10, fh, WRITE_BACK);
+    std::vector<std::vector<int>> rects = rectGenerator(2000, 2000);
+    for (const std::vector<int>& rect : rects) {
+        rt.insert(rect, fh);
+    }
+    std::vector<std::vector<int>> queries = rectGenerator(200, 3000);
+    queries.insert(queries.end(), rects.begin(), rects.begin() + 100);
+    bool passed = rt.height > 1;
+    for (const std::vector<int>& p : queries) {
+        bool expected = scanSearch(rt, rects, p);
+        if (rt.search(p, rt.rootPageId, fh) != expected || searchDepthFirst(rt, p, rt.rootPageId, fh) != expected) {
+            passed = false;
+        }
+    }
+    fm.closeFile(fh);
+    fm.destroyFile(fileName.c_str());
+    return passed;
+}
+
+// a write back tree read through a second handle of its file after a checkpoint, the buffer holds every page so none is written before
+bool checkCheckpoint() {
+    FileManager fm(1024);
+    std::string fileName;
+    FileHandler fh = createScratch(fm, fileName, "checkpoint");
+    RTree rt = RTree(10, fh, WRITE_BACK);
+    std::vector<std::vector<int>> rects = rectGenerator(2000, 200);
+    for (const std::vector<int>& rect : rects) {
+        rt.insert(rect, fh);
+    }
+    fh.checkpoint(true);
+    // the second handle reads the header and pages from the file, not from the frames of the first
+    FileHandler reopened = fm.openFile(fileName.c_str());
+    std::vector<std::vector<int>> queries = rectGenerator(200, 100);
+    queries.insert(queries.end(), rects.begin(), rects.begin() + 100);
+    bool passed = true;
+    try {
+        for (const std::vector<int>& p : queries) {
+            if (rt.search(p, rt.rootPageId, reopened) != scanSearch(rt, rects, p)) passed = false;
+        }
+    }
+    catch (const std::exception&) {
+        // pages past the header's count are invalid
+        passed = false;
+    }
+    fm.closeFile(reopened);
+    fm.closeFile(fh);
+    fm.destroyFile(fileName.c_str());
+    return passed;
+}
+
+/*
+a fixed trace on a buffer of 8 frames: pages 0 - 9 are read, 0 and 1 are read
+twice more, then a scan reads 10 - 17. LRU and CLOCK keep the scan, 2Q and
+LRU-K keep 0 and 1 and the last six pages of the scan. the pages kept are
+found by overwriting the file behind the buffer, a page still in a frame
+reads as before
+*/
+bool checkPolicy(int policy, const std::vector<int>& kept) {
+    FileManager fm(8, policy);
+    std::string fileName;
+    FileHandler fh = createScratch(fm, fileName, "policy");
+    for (int i = 0; i < 20; i++) {
+        PageHandler ph = fh.newPage();
+        memcpy(ph.getData(), &i, sizeof(int));
+        fh.markDirty(ph.getPageNum());
+        fh.unpinPage(ph.getPageNum());
+    }
+    fh.flushPages();
+    fm.clearBuffer();
+    std::vector<int> trace = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 0, 1, 10, 11, 12, 13, 14, 15, 16, 17};
+    for (int pageNum : trace) {
+        fh.pageAt(pageNum);
+        fh.unpinPage(pageNum);
+    }
+    int fd = open(fileName.c_str(), O_WRONLY);
+    int overwritten = -1;
+    for (int i = 0; i < 20; i++) {
+        pwrite(fd, &overwritten, sizeof(int), FILE_HDR_SIZE + (long)i * PAGE_SIZE + sizeof(PageHdr));
+    }
+    close(fd);
+    // the buffer is full, so reading the pages kept evicts none of them
+    bool passed = true;
+    for (int pageNum : kept) {
+        PageHandler ph = fh.pageAt(pageNum);
+        int stored;
+        memcpy(&stored, ph.getData(), sizeof(int));
+        fh.unpinPage(pageNum);
+        if (stored != pageNum) passed = false;
+    }
+    fm.closeFile(fh);
+    fm.destroyFile(fileName.c_str());
+    return passed;
+}
+
+// threads searching one tree at once, on a buffer smaller than the tree so pages are evicted meanwhile
+bool checkConcurrentSearch(int threadNum) {
+    FileManager fm;
+    std::string fileName;
+    FileHandler fh = createScratch(fm, fileName, "concurrent");
+    RTree rt = RTree(10, fh, WRITE_BACK);
+    std::vector<std::vector<int>> rects = rectGenerator(3000, 200);
+    for (const std::vector<int>& rect : rects) {
+        rt.insert(rect, fh);
+    }
+    std::vector<std::vector<int>> queries = rectGenerator(300, 100);
+    queries.insert(queries.end(), rects.begin(), rects.begin() + 300);
+    std::vector<bool> expected;
+    for (const std::vector<int>& p : queries) {
+        expected.push_back(scanSearch(rt, rects, p));
+    }
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadNum; t++) {
+        threads.emplace_back([&, t]() {
+            try {
+                // every thread starts somewhere else in the queries
+                for (size_t i = 0; i < queries.size(); i++) {
+                    size_t q = (i + t * queries.size() / threadNum) % queries.size();
+                    if (rt.search(queries[q], rt.rootPageId, fh) != expected[q]) mismatches += 1;
+                }
+            }
+            catch (const std::exception&) {
+                mismatches += 1;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    fm.closeFile(fh);
+    fm.destroyFile(fileName.c_str());
+    return mismatches == 0;
+}
+
+// the byte at offset of page pageNum written by checkPageIO
+char pageByte(int pageNum, int offset) {
+    return (char)(pageNum * 31 + offset);
+}
+
+/*
+pages written by a checkpoint, whose runs of adjacent pages go out with one
+pwritev each, read back byte by byte with pread and through a scan of a
+second handle, which reads ahead with preadv
+*/
+bool checkPageIO(int pageNum) {
+    FileManager fm(2 * pageNum);
+    std::string fileName;
+    FileHandler fh = createScratch(fm, fileName, "pageio");
+    for (int i = 0; i < pageNum; i++) {
+        PageHandler ph = fh.newPage();
+        for (int j = 0; j < PAGE_CONTENT_SIZE; j++) {
+            ph.getData()[j] = pageByte(i, j);
+        }
+        fh.markDirty(ph.getPageNum());
+        fh.unpinPage(ph.getPageNum());
+    }
+    fh.checkpoint(true);
+    bool passed = true;
+    std::vector<char> page(PAGE_CONTENT_SIZE);
+    int fd = open(fileName.c_str(), O_RDONLY);
+    for (int i = 0; i < pageNum && passed; i++) {
+        if (pread(fd, &page[0], PAGE_CONTENT_SIZE, FILE_HDR_SIZE + (long)i * PAGE_SIZE + sizeof(PageHdr)) != PAGE_CONTENT_SIZE) passed = false;
+        for (int j = 0; j < PAGE_CONTENT_SIZE && passed; j++) {
+            if (page[j] != pageByte(i, j)) passed = false;
+        }
+    }
+    close(fd);
+    FileHandler reopened = fm.openFile(fileName.c_str());
+    int scanned = 0;
+    for (PageHandler ph = reopened.firstPage(); ph.getPageNum() != -1 && passed; ph = reopened.nextPage(ph.getPageNum())) {
+        for (int j = 0; j < PAGE_CONTENT_SIZE && passed; j++) {
+            if (ph.getData()[j] != pageByte(ph.getPageNum(), j)) passed = false;
+        }
+        reopened.unpinPage(ph.getPageNum());
+        scanned += 1;
+    }
+    fm.closeFile(reopened);
+    fm.closeFile(fh);
+    fm.destroyFile(fileName.c_str());
+    return passed && scanned == pageNum;
+}
+
+// print the outcome of one brute-force check
+bool report(const std::string& name, bool passed) {
+    std::cout << name << ": " << (passed ? "passed" : "failed") << "\n";
+    return passed;
+}
+
 // input, maxCap, dimension, output
 // void rTreesCreator(const std::string& folderPath, int amount, int maxCap) {
 //     std::string fileName = folderPath + "RTree_" + std::to_string(amount) + ".txt";
@@ -84,6 +317,24 @@ void generateFiles(const std::string& filePath, int n) {
 }
 
 int main(){
+    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    std::cout << "====== Brute-force Checks ======\n";
+    bool passed = true;
+    passed = report("Search, io_uring reads", checkSearch(URING_BACKEND)) && passed;
+    passed = report("Search, thread pool reads", checkSearch(THREAD_BACKEND)) && passed;
+    passed = report("Write back checkpoint", checkCheckpoint()) && passed;
+    passed = report("Concurrent search", checkConcurrentSearch(8)) && passed;
+    passed = report("Batched page I/O", checkPageIO(200)) && passed;
+    passed = report("LRU replacement", checkPolicy(LRU_POLICY, {10, 11, 12, 13, 14, 15, 16, 17})) && passed;
+    passed = report("CLOCK replacement", checkPolicy(CLOCK_POLICY, {10, 11, 12, 13, 14, 15, 16, 17})) && passed;
+    passed = report("2Q replacement", checkPolicy(TWO_Q_POLICY, {0, 1, 12, 13, 14, 15, 16, 17})) && passed;
+    passed = report("LRU-K replacement", checkPolicy(LRU_K_POLICY, {0, 1, 12, 13, 14, 15, 16, 17})) && passed;
+    std::cout << std::endl;
+    if (!passed) {
+        std::cout << "Brute-force check failed" << std::endl;
+        return 1;
+    }
+
     std::string filePath = "./data/data0.txt";
     readFileToTree(filePath.c_str());
 
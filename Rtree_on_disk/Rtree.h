@@ -2,6 +2,7 @@
 #define RTREE_H
 
 #include <limits>
+#include <climits>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -44,6 +45,15 @@ Node::Node(int maxCap) {
     size = 0;
 }
 
+/*
+how node updates reach the file:
+0 - write through, every diskWrite writes its page and drops it from the buffer
+1 - write back, dirty pages stay in the buffer until they are evicted or
+    FileHandler::checkpoint / closeFile writes them in order of page number
+*/
+const int WRITE_THROUGH = 0;
+const int WRITE_BACK = 1;
+
 class RTree{
 public:
     // int d;        // dimension of points in R tree
@@ -53,9 +63,11 @@ public:
     int rootPageId;
     int height;
     int noOfElement;
+    int writeMode;
     // RTree(int dim, int maxChildren, FileHandler& fh);
-    RTree(int maxChildren, FileHandler& fh);
+    RTree(int maxChildren, FileHandler& fh, int _writeMode = WRITE_THROUGH);
     Node diskRead(int id,FileHandler& fh);              // read the page corresponding to the node to disk
+    Node diskRead(PageHandler& ph,FileHandler& fh);     // read the node of a page pinned by the caller, the page is unpinned
     Node diskWrite(Node& n,FileHandler& fh);            // write the page corresponding to the node to disk
     Node allocateNode(FileHandler&,int parentid);       // Allocate page for the node
     bool equal(Node& n1,Node& n2);                      //check if two Node are equal or not just for debugging purpose
@@ -98,7 +110,8 @@ public:
 //     diskWrite(root, fh);
 // }
 
-RTree::RTree(int maxChildren, FileHandler &fh) {
+RTree::RTree(int maxChildren, FileHandler &fh, int _writeMode) {
+    writeMode = _writeMode;
     maxCap = (PAGE_CONTENT_SIZE - 8 * 2 - 16) / (8 * 2 + 4);
     maxCap = std::min(maxChildren, maxCap);
     maxCap = std::max(3, maxCap);
@@ -116,6 +129,8 @@ Node RTree::allocateNode(FileHandler &fh, int parentId) {
     PageHandler ph = fh.newPage();
     Node n = Node(maxCap);
     n.pageId = ph.getPageNum();
+    // the page is filled by diskWrite, no pin is kept meanwhile
+    fh.unpinPage(n.pageId);
     // std::cout <<"Allocated " << n.pageId << "\n";
     n.parentId = parentId;
     return n;
@@ -134,18 +149,30 @@ Node RTree::diskWrite(Node &n, FileHandler &fh) {
     }
     v.push_back(n.leaf);
     v.push_back(n.size);
+    fh.latchPage(n.pageId, true);
     memcpy(&data[0], &v[0], v.size() * sizeof(int));
+    fh.unlatchPage(n.pageId, true);
     fh.markDirty(n.pageId);
     fh.unpinPage(n.pageId);
-    fh.flushPage(n.pageId);
+    if (writeMode == WRITE_THROUGH) fh.flushPage(n.pageId);
     return n;
 }
 
 Node RTree::diskRead(int id, FileHandler &fh) {
     PageHandler ph = fh.pageAt(id);
+    return diskRead(ph, fh);
+}
+
+Node RTree::diskRead(PageHandler &ph, FileHandler &fh) {
+    int id = ph.getPageNum();
     char *data = ph.getData();
     std::vector<int> v(noOfElement);
+    // readers share the page, a writer waits for them
+    fh.latchPage(id);
     memcpy(&v[0], &data[0], noOfElement * sizeof(int));
+    fh.unlatchPage(id);
+    // the node is a copy, the page need not stay pinned
+    fh.unpinPage(id);
     Node n = Node(maxCap);
     n.pageId = v[0];
     n.parentId = v[1];
@@ -232,10 +259,10 @@ std::vector<int> RTree::minBoundingRegion(const std::vector<std::vector<int>> &E
     return mbr;
 }
 
+// diskRead keeps no pin, so freeing a node only flushes its page, and in write back mode leaves it cached
 bool RTree::freeNode(const Node &n, FileHandler &fh) {
-    bool res = fh.unpinPage(n.pageId);
-    res = res && fh.flushPage(n.pageId);
-    return (res);
+    if (writeMode == WRITE_BACK) return true;
+    return fh.flushPage(n.pageId);
 }
 
 int RTree::leastIncreasingMBR(const std::vector<int> &p, const std::vector<std::vector<int>> &possMBRs, int nsize) {
@@ -315,8 +342,9 @@ void RTree::splitChild(int k, Node &n, FileHandler &fh) {
     diskWrite(n2, fh);
 }
 
+// the pair of entries wasting the most area together, overlapping entries waste a negative area
 std::vector<int> RTree::seed(const Node &n) {
-    double maxdiff = -1;
+    double maxdiff = -DOUBLE_MAX;
     int e1, e2;
     e1 = e2 = -1;
     for (int i = 0; i < n.size; i++) {
@@ -403,17 +431,32 @@ std::vector<Node> RTree::quadraticSplit(const Node &n, FileHandler &fh) {
     return (std::vector<Node>({n1, n2}));
 }
 
+/*
+search level by level: the children of a level whose MBR contains p are read
+at once, see FileHandler::pagesAt. once a leaf holds p, the pages of the
+level still arriving are only unpinned
+*/
 bool RTree::search(const std::vector<int> &p, int nodeid, FileHandler &fh) {
-    Node n = diskRead(nodeid, fh);
+    std::vector<int> level(1, nodeid);
     bool find = false;
-    for (int i = 0; i < n.size && !find; i++) {
-        if (contains(p, n.childMBR[i])) {
-            int childId = n.childptr[i];
-            if (!n.leaf) find = find || search(p, childId, fh);
-            else find = find || true;
-        }
+    while (!level.empty() && !find) {
+        std::vector<int> next;
+        fh.pagesAt(level, [&](PageHandler &ph) {
+            if (find) {
+                if (ph.getPageNum() != -1) fh.unpinPage(ph.getPageNum());
+                return;
+            }
+            Node n = diskRead(ph, fh);
+            for (int i = 0; i < n.size && !find; i++) {
+                if (contains(p, n.childMBR[i])) {
+                    if (!n.leaf) next.push_back(n.childptr[i]);
+                    else find = true;
+                }
+            }
+            freeNode(n, fh);
+        });
+        level.swap(next);
     }
-    freeNode(n, fh);
     return find;
 }
 
@@ -0,0 +1,311 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include "config.h"
+#include "errors.h"
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
+
+using namespace std;
+
+/*
+backends of AsyncReader:
+0 - io_uring, reads go to the kernel through a submission ring and come back
+    on a completion ring, a batch costs one system call
+1 - a few threads doing pread, for kernels without io_uring. io_uring falls
+    back to it when the ring cannot be set up or does not support reads
+*/
+const int URING_BACKEND = 0;
+const int THREAD_BACKEND = 1;
+
+/*
+reads of whole pages in flight at once. submit queues a read, send starts
+the queued reads, and wait returns the tag and result of the next read to
+finish, in any order. an object is used by one thread at a time, the buffer
+keeps a pool of them
+*/
+class AsyncReader {
+public:
+    AsyncReader(int _backend, int _depth);
+    AsyncReader(const AsyncReader& other) = delete;
+    AsyncReader& operator = (const AsyncReader& other) = delete;
+    ~AsyncReader();
+    int getBackend() const;
+    int capacity() const;
+    int pending() const;
+    void submit(int fd, char* dest, int length, long offset, int tag);
+    void send();
+    bool wait(int& tag, int& result);
+
+private:
+    int backend;
+    int depth; // reads in flight at most
+    int inFlight;
+    // io_uring
+    int ringFd;
+    void* sqRing;
+    void* cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    unsigned toSubmit; // reads in the submission ring the kernel has not taken yet
+#ifdef HAVE_IO_URING
+    io_uring_sqe* sqes;
+    io_uring_cqe* cqes;
+#endif
+    bool setupRing();
+    bool probeRead();
+    void closeRing();
+    int enter(unsigned submit, unsigned complete);
+    // thread fallback
+    struct Request {
+        int fd;
+        char* dest;
+        int length;
+        long offset;
+        int tag;
+    };
+    vector<thread> threads;
+    mutex lock;
+    condition_variable requestReady;
+    condition_variable completionReady;
+    deque<Request> requests;
+    deque<pair<int, int>> completions; // tag and result
+    bool stopping;
+    void serve();
+};
+
+AsyncReader::AsyncReader(int _backend, int _depth) {
+	this -> backend = _backend;
+	this -> depth = max(1, _depth);
+	this -> inFlight = 0;
+	this -> ringFd = -1;
+	this -> toSubmit = 0;
+	this -> stopping = false;
+	if(backend == URING_BACKEND && !setupRing()) backend = THREAD_BACKEND;
+	if(backend == THREAD_BACKEND) {
+		for(int i = 0; i < min(depth, ASYNC_THREADS); i++)
+			threads.push_back(thread(&AsyncReader::serve, this));
+	}
+}
+
+AsyncReader::~AsyncReader() {
+	if(backend == URING_BACKEND) {
+		closeRing();
+		return;
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	requestReady.notify_all();
+	for(thread& worker : threads) worker.join();
+}
+
+// the backend in use, THREAD_BACKEND when io_uring was asked for and is not there
+int AsyncReader::getBackend() const {
+	return backend;
+}
+
+int AsyncReader::capacity() const {
+	return depth;
+}
+
+// reads submitted and not yet returned by wait
+int AsyncReader::pending() const {
+	return inFlight;
+}
+
+// map the rings of a new io_uring instance, false when the kernel has none
+bool AsyncReader::setupRing() {
+#ifdef HAVE_IO_URING
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ringFd = syscall(__NR_io_uring_setup, depth, &params);
+	if(ringFd < 0) return false;
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	// newer kernels map both rings at once
+	bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+	if(single) sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+	sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	cqRing = single ? sqRing : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void* entries = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || entries == MAP_FAILED) {
+		if(entries != MAP_FAILED) munmap(entries, sqesSize);
+		if(cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+		if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+		close(ringFd);
+		return false;
+	}
+	sqes = (io_uring_sqe*)entries;
+	sqTail = (unsigned*)((char*)sqRing + params.sq_off.tail);
+	sqMask = (unsigned*)((char*)sqRing + params.sq_off.ring_mask);
+	sqArray = (unsigned*)((char*)sqRing + params.sq_off.array);
+	cqHead = (unsigned*)((char*)cqRing + params.cq_off.head);
+	cqTail = (unsigned*)((char*)cqRing + params.cq_off.tail);
+	cqMask = (unsigned*)((char*)cqRing + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe*)((char*)cqRing + params.cq_off.cqes);
+	depth = min(depth, (int)params.sq_entries);
+	if(!probeRead()) {
+		closeRing();
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+true when the ring runs IORING_OP_READ. kernels 5.1 to 5.5 set up a ring
+but fail every such read with -EINVAL, and they have no probe either, so a
+failed probe means no reads
+*/
+bool AsyncReader::probeRead() {
+#if defined(HAVE_IO_URING) && defined(IO_URING_OP_SUPPORTED)
+	// the probe is followed by one entry per opcode
+	vector<io_uring_probe_op> space(2 + IORING_OP_LAST);
+	io_uring_probe* probe = (io_uring_probe*)&space[0];
+	if(syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) return false;
+	return probe -> last_op >= IORING_OP_READ && (probe -> ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+#else
+	return false;
+#endif
+}
+
+// unmap the rings and close the ring set up by setupRing
+void AsyncReader::closeRing() {
+#ifdef HAVE_IO_URING
+	munmap(sqes, sqesSize);
+#endif
+	if(cqRing != sqRing) munmap(cqRing, cqRingSize);
+	munmap(sqRing, sqRingSize);
+	close(ringFd);
+	ringFd = -1;
+}
+
+// hand submit reads to the kernel and wait until complete have finished
+int AsyncReader::enter(unsigned submit, unsigned complete) {
+#ifdef HAVE_IO_URING
+	unsigned flags = complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+	while(true) {
+		int res = syscall(__NR_io_uring_enter, ringFd, submit, complete, flags, NULL, 0);
+		if(res >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) return res;
+	}
+#else
+	return -1;
+#endif
+}
+
+// queue a read of length bytes at offset into dest, at most capacity() in flight
+void AsyncReader::submit(int fd, char* dest, int length, long offset, int tag) {
+	inFlight += 1;
+	if(backend == THREAD_BACKEND) {
+		{
+			lock_guard<mutex> guard(lock);
+			requests.push_back(Request{fd, dest, length, offset, tag});
+		}
+		requestReady.notify_one();
+		return;
+	}
+#ifdef HAVE_IO_URING
+	// this thread is the only producer, the kernel reads the tail
+	unsigned tail = *sqTail;
+	unsigned index = tail & *sqMask;
+	io_uring_sqe* sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe -> opcode = IORING_OP_READ;
+	sqe -> fd = fd;
+	sqe -> addr = (unsigned long)dest;
+	sqe -> len = length;
+	sqe -> off = offset;
+	sqe -> user_data = tag;
+	sqArray[index] = index;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+	toSubmit += 1;
+#endif
+}
+
+// start the queued reads, one system call for all of them
+void AsyncReader::send() {
+	if(backend != URING_BACKEND || toSubmit == 0) return;
+	int res = enter(toSubmit, 0);
+	if(res > 0) toSubmit -= min((unsigned)res, toSubmit);
+}
+
+/*
+wait for the next read to finish, result is the number of bytes read or
+-errno. false when no read is in flight
+*/
+bool AsyncReader::wait(int& tag, int& result) {
+	if(inFlight == 0) return false;
+	if(backend == THREAD_BACKEND) {
+		unique_lock<mutex> guard(lock);
+		completionReady.wait(guard, [this]() { return !completions.empty(); });
+		tag = completions.front().first;
+		result = completions.front().second;
+		completions.pop_front();
+		inFlight -= 1;
+		return true;
+	}
+#ifdef HAVE_IO_URING
+	while(true) {
+		unsigned head = *cqHead;
+		if(head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+			io_uring_cqe* cqe = &cqes[head & *cqMask];
+			tag = (int)cqe -> user_data;
+			result = cqe -> res;
+			__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+			inFlight -= 1;
+			return true;
+		}
+		int res = enter(toSubmit, 1);
+		if(res < 0) throw BufferManagerException("BufferManagerException : io_uring_enter failed");
+		toSubmit -= min((unsigned)res, toSubmit);
+	}
+#endif
+	return false;
+}
+
+// a thread of the fallback, runs the queued reads with pread
+void AsyncReader::serve() {
+	while(true) {
+		Request request;
+		{
+			unique_lock<mutex> guard(lock);
+			requestReady.wait(guard, [this]() { return stopping || !requests.empty(); });
+			if(requests.empty()) return;
+			request = requests.front();
+			requests.pop_front();
+		}
+		int res = pread(request.fd, request.dest, request.length, request.offset);
+		if(res < 0) res = -errno;
+		{
+			lock_guard<mutex> guard(lock);
+			completions.push_back(make_pair(request.tag, res));
+		}
+		completionReady.notify_one();
+	}
+}
+
+#endif
@@ -4,15 +4,21 @@
 #include "config.h"
 #include "diskManager.h"
 #include "errors.h"
+#include "asyncIO.h"
 #include <unordered_map>
 #include <unistd.h>
 #include <iostream>
 #include <algorithm>
 #include <cstdio>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <cstring>
 #include <cstdlib>
 #include <list>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 
 using namespace std;
 
@@ -40,83 +46,505 @@ namespace std {
     };
 }
 
+/*
+a frame is pinned by every user of its page and only a frame with no pins
+is evicted. the latch guards the bytes of the page: shared to read them,
+exclusive to change them, taken by the users while they hold a pin, so a
+latched frame is always pinned. while the page is read in loading is set,
+and the users wait for it to clear
+*/
 struct Frame {
-    PageDescriptor pageDescriptor;
+    PageDescriptor pageDescriptor; // fd -1 when the frame is free
     bool dirty;
-    bool pinned;
+    atomic<int> pinCount;
+    shared_mutex latch;
+    atomic<bool> loading; // the page is being read in
+    atomic<bool> loaded; // the page has been read in
     char* data;
+    int prev; // neighbours in the frame's queue, -1 at the ends
+    int next;
+    int queue; // queue holding the frame, -1 when it is in none
+    atomic<bool> referenced; // reference bit of CLOCK
+    long lastUse; // LRU-K: times of the last two references, 0 when there is none
+    long prevUse;
 };
 
+// queue of frames linked through Frame::prev / next, the front is the most recently used
+struct FrameQueue {
+    int head;
+    int tail;
+    int size;
+    FrameQueue() : head(-1), tail(-1), size(0) {}
+};
+
+// one part of the page table, with its own lock
+struct HashShard {
+    mutex lock;
+    unordered_map<PageDescriptor, int> table; // pageDescriptor and the slot it stored in buffer
+};
+
+/*
+replacement policies, chosen when the buffer is created:
+0 - LRU, one queue of frames in order of use
+1 - CLOCK, a hand sweeps the frames and evicts the first one whose reference
+    bit is already clear
+2 - 2Q, a page read for the first time enters a FIFO queue, and only a page
+    referenced again after it left that queue enters the LRU queue. a scan
+    touching many pages once only cycles the FIFO queue
+3 - LRU-K with K = 2, the page whose second to last reference is oldest is
+    evicted, pages referenced once go first
+with 2Q and LRU-K the pages near the root of a tree, read by every search,
+stay in the buffer while the leaves of a scan come and go
+*/
+const int LRU_POLICY = 0;
+const int CLOCK_POLICY = 1;
+const int TWO_Q_POLICY = 2;
+const int LRU_K_POLICY = 3;
+
+/*
+the buffer can be shared by many threads. the page table is split into
+HASH_SHARDS shards, so looking up, pinning and unpinning pages of different
+shards never wait on each other. the free list and the replacement policy
+are kept under one replacement lock, taken when a page is loaded or evicted
+and, except for CLOCK, to record a use. a page is read from the file with
+no lock held, other threads asking for it pin the frame and wait on
+loadDone. locks are taken in the order replacement lock, shard, and no
+latch is waited for while one is held. pages are read and written with
+pread / pwrite, which leave the file offset alone, so threads do I/O on the
+same file at once. the page descriptor of a frame changes only under both
+locks. getPages reads many pages at once through an AsyncReader and waits
+for pages loaded by other threads only once its own reads are done, so two
+callers never wait on each other's reads. pages are allocated and disposed
+of by one thread at a time, see FileHandler
+*/
 class BufferManager {
 public:
-    BufferManager(int num_pages);
+    BufferManager(int num_pages, int _policy = LRU_POLICY, int _asyncBackend = URING_BACKEND);
     ~BufferManager();
     char* getPage(PageDescriptor pd);
+    template <typename Visitor>
+    void getPages(const vector<PageDescriptor>& pds, Visitor&& visit);
     char* allocatePage(PageDescriptor pd);
+    void prefetch(PageDescriptor pd, int count);
     bool markDirty(PageDescriptor pd);
     bool unpinPage(PageDescriptor pd);
+    bool latchPage(PageDescriptor pd, bool exclusive);
+    bool unlatchPage(PageDescriptor pd, bool exclusive);
     bool flushPage(PageDescriptor pd);
     bool flushPages(int fd);
+    bool checkpoint(int fd, bool sync);
     void clearBuffer();
     void printBuffer();
 
 private:
     list<int> freeList;
-    list<int> LRUList;
     Frame* buffers;
     int numPages;
     int pageSize;
-    unordered_map<PageDescriptor, int> hashTable; // pageDescriptor and the slot it stored in buffer
+    int policy;
+    int asyncBackend;
+    HashShard shards[HASH_SHARDS];
+    mutex replacerLock; // guards freeList and the structures of the policy below
+    mutex loadLock; // with loadDone, wakes the users of frames being read in
+    condition_variable loadDone;
+    FrameQueue recent; // LRU queue, also the frequent queue (Am) of 2Q
+    FrameQueue incoming; // FIFO queue (A1in) of 2Q
+    list<PageDescriptor> ghosts; // 2Q: pages recently evicted from incoming, newest first (A1out)
+    unordered_map<PageDescriptor, list<PageDescriptor>::iterator> ghostTable;
+    int hand; // CLOCK hand
+    long useCount; // LRU-K clock, counts the references
+    set<pair<pair<long, long>, int>> history; // LRU-K: (prevUse, lastUse) and slot of every frame, victim first
+    atomic<int> asyncSpare; // frames getPages calls may still fill beyond the first read of each
+    mutex readerLock; // guards readers
+    vector<AsyncReader*> readers; // readers not in use by a getPages call
+    /*
+    the state of one getPages call: its reader and the pins it holds. the
+    destructor runs also when visit throws: it waits for the reads still in
+    flight, unpins their pages and the deferred ones, and puts the reader
+    back into the pool, so no frame stays pinned and no reader is lost
+    */
+    struct ReadBatch {
+        BufferManager& manager;
+        const vector<PageDescriptor>& pds;
+        AsyncReader* reader;
+        vector<int> slots; // frame of every page, -1 until it is claimed
+        vector<int> deferred; // pages another thread is reading
+        int held; // pins of this call
+        int spares; // pins beyond the first, taken from asyncSpare
+        ReadBatch(BufferManager& _manager, const vector<PageDescriptor>& _pds);
+        ReadBatch(const ReadBatch& other) = delete;
+        ReadBatch& operator = (const ReadBatch& other) = delete;
+        ~ReadBatch();
+        bool take();
+        void drop();
+    };
+    HashShard& shardOf(const PageDescriptor& pd);
+    int lookup(PageDescriptor pd);
+    int claimFrame(PageDescriptor pd, int& slotNo);
+    char* pinLoaded(int slot);
+    bool waitLoaded(int slot);
+    void finishLoad(int slot);
+    AsyncReader* acquireReader();
+    void releaseReader(AsyncReader* reader);
     int findSlot();
+    int pickVictim();
+    int victimFrom(FrameQueue& queue);
+    bool evict(int slot);
+    bool writeBack(int slot);
+    bool writeBackPages(const vector<int>& slots);
+    bool writeRun(vector<int>& run);
+    vector<int> framesOf(int fd);
+    void admit(int slot);
+    void reference(int slot, bool request);
+    void touch(int slot, bool reference);
+    void detach(int slot);
+    void release(int slot);
+    void dropFailed(int slot);
+    void abandonLoad(int slot);
+    void pushFront(FrameQueue& queue, int queueId, int slot);
+    void unlink(int slot);
     bool readPage(PageDescriptor pd, char* dest);
     bool writePage(PageDescriptor pd, char* data);
     void initializeBuffer(PageDescriptor pd, int slow_no);
 };
 
-BufferManager::BufferManager(int num_buffers) {
+BufferManager::BufferManager(int num_buffers, int _policy, int _asyncBackend) {
 	this -> numPages = num_buffers;
 	this -> pageSize = PAGE_SIZE;
+	this -> policy = _policy;
+	this -> asyncBackend = _asyncBackend;
+	this -> asyncSpare = max(0, num_buffers / 4);
+	this -> hand = 0;
+	this -> useCount = 0;
 	this -> buffers = new Frame[num_buffers];
 	for(int i = 0; i < num_buffers; i++) {
 		buffers[i].data = new char[this -> pageSize];
+		buffers[i].dirty = false;
+		buffers[i].pinCount = 0;
+		buffers[i].loading = false;
+		buffers[i].loaded = false;
+		buffers[i].prev = buffers[i].next = buffers[i].queue = -1;
+		buffers[i].referenced = false;
+		buffers[i].lastUse = buffers[i].prevUse = 0;
 		freeList.push_back(i);
 	}
 }
 
 BufferManager::~BufferManager() {
 	for(int i = 0; i < this -> numPages; i++) 
-	    delete buffers[i].data;
-	delete this -> buffers;
+	    delete[] buffers[i].data;
+	delete[] this -> buffers;
 	freeList.clear();
-	LRUList.clear();
-	hashTable.clear();
+	for(AsyncReader* reader : readers) delete reader;
+}
+
+HashShard& BufferManager::shardOf(const PageDescriptor& pd) {
+	return shards[hash<PageDescriptor>()(pd) % HASH_SHARDS];
+}
+
+// the slot of a page in the buffer, -1 when it is not there
+int BufferManager::lookup(PageDescriptor pd) {
+	HashShard& shard = shardOf(pd);
+	lock_guard<mutex> guard(shard.lock);
+	auto slot = shard.table.find(pd);
+	return slot == shard.table.end() ? -1 : slot -> second;
 }
 
+/*
+pin pd for the caller. 0 when the page is in the buffer, 1 when it is not
+and slotNo is a new frame for it, marked loading, which the caller fills
+and hands to finishLoad or abandonLoad. -1 when every frame is pinned
+*/
+int BufferManager::claimFrame(PageDescriptor pd, int& slotNo) {
+	HashShard& shard = shardOf(pd);
+	{
+		lock_guard<mutex> guard(shard.lock);
+		auto slot = shard.table.find(pd);
+		if(slot != shard.table.end()) {
+			//already in buffer, no need to read the page, pin it
+			slotNo = slot -> second;
+			buffers[slotNo].pinCount += 1;
+			return 0;
+		}
+	}
+	// page not in buffers
+	// find a suitable slot to load it, before the shard is locked as the victim may live there
+	lock_guard<mutex> replacer(replacerLock);
+	int freeSlot = findSlot();
+	if(freeSlot == -1) return -1; //no free slot could be obtained
+	lock_guard<mutex> guard(shard.lock);
+	auto slot = shard.table.find(pd);
+	if(slot != shard.table.end()) {
+		// another thread loaded the page meanwhile
+		freeList.push_front(freeSlot);
+		slotNo = slot -> second;
+		buffers[slotNo].pinCount += 1;
+		return 0;
+	}
+	slotNo = freeSlot;
+	// the frame is marked before it is published, so others wait for the read
+	buffers[slotNo].loading = true;
+	buffers[slotNo].loaded = false;
+	shard.table.insert(make_pair(pd, slotNo));
+	// initialize the rest of Frame elements
+	initializeBuffer(pd, slotNo);
+	return 1;
+}
 
+// return the page pinned, the caller unpins it with unpinPage
 char* BufferManager::getPage(PageDescriptor pd) {
-	auto slot = hashTable.find(pd);
-	if(slot != hashTable.end()) {
-		//already in buffer 
-		int slotNo = slot -> second;
-		// no need to read the page
-		// to establish replacement policy, make page MRU 
-		LRUList.remove(slotNo); 
-		LRUList.push_front(slotNo); // put at front
-		return buffers[slotNo].data;
+	int slotNo;
+	int state = claimFrame(pd, slotNo);
+	if(state == -1) throw NoBufferSpaceException (); //error no free slot could be obtained 
+	if(state == 0) {
+		// a new reference for the replacement policy
+		reference(slotNo, true);
+		return pinLoaded(slotNo);
 	}
-	else {
-		// page not in buffers
-		// find a suitable slot to load it
-		int slotNo = findSlot();
-		if(slotNo == -1) throw NoBufferSpaceException (); //error no free slot could be obtained 
-		// read data to buffers[slotNo].data
-		bool _read_res = readPage(pd, buffers[slotNo].data);
-		if(!_read_res) throw BufferManagerException("BufferManagerException : Read request failed");
-		// insert into hashTable the corresponding slot
-		hashTable.insert(make_pair(pd, slotNo));
-		// initialize the rest of Frame elements
-		initializeBuffer(pd, slotNo);
-		return buffers[slotNo].data;
+	// read data to buffers[slotNo].data, no lock is held
+	bool _read_res = readPage(pd, buffers[slotNo].data);
+	if(!_read_res) {
+		abandonLoad(slotNo);
+		throw BufferManagerException("BufferManagerException : Read request failed");
+	}
+	finishLoad(slotNo);
+	return buffers[slotNo].data;
+}
+
+/*
+pin every page of pds and call visit(k, data) for pds[k] once it is in the
+buffer, the caller unpins it. the missing pages are read at once through an
+AsyncReader and visited in the order their reads finish, the pages already
+there as they are met. a call holds one pin, like getPage, and more up to
+ASYNC_QUEUE_DEPTH reads in flight while asyncSpare lasts, so all calls
+together hold at most a quarter of the frames beyond one each. throws after
+every page has been visited or dropped when one could not be read. when
+visit throws, the page handed to it stays pinned for the caller and the
+pins of the pages not yet visited are dropped, see ReadBatch
+*/
+template <typename Visitor>
+void BufferManager::getPages(const vector<PageDescriptor>& pds, Visitor&& visit) {
+	// a single page gains nothing from the reader
+	if(pds.size() == 1) {
+		visit(0, getPage(pds[0]));
+		return;
+	}
+	ReadBatch batch(*this, pds);
+	AsyncReader* reader = batch.reader;
+	vector<int>& slots = batch.slots;
+	vector<int>& deferred = batch.deferred;
+	bool failed = false;
+	size_t next = 0;
+	while(next < pds.size() || reader -> pending() > 0 || !deferred.empty()) {
+		// claim frames and queue the reads of the missing pages while there is room
+		bool visited = false;
+		while(next < pds.size() && reader -> pending() < reader -> capacity() && batch.take()) {
+			int state = claimFrame(pds[next], slots[next]);
+			if(state == -1) {
+				batch.drop();
+				break;
+			}
+			if(state == 1) {
+				long offset = pds[next].pagenum * (long)pageSize + FILE_HDR_SIZE;
+				reader -> submit(pds[next].fd, buffers[slots[next]].data, pageSize, offset, next);
+			}
+			else {
+				// a page already there is visited at once, while the reads queued so far run
+				reader -> send();
+				reference(slots[next], true);
+				if(buffers[slots[next]].loaded) {
+					// the pin goes to visit
+					batch.drop();
+					visited = true;
+					visit(next, buffers[slots[next]].data);
+				}
+				else deferred.push_back(next);
+			}
+			next += 1;
+		}
+		reader -> send();
+		int tag, result;
+		if(reader -> wait(tag, result)) {
+			batch.drop();
+			if(result == pageSize) {
+				finishLoad(slots[tag]);
+				visit(tag, buffers[slots[tag]].data);
+			}
+			else {
+				abandonLoad(slots[tag]);
+				failed = true;
+			}
+			continue;
+		}
+		// no read of ours in flight, the reads of others can be waited for
+		bool waited = !deferred.empty();
+		while(!deferred.empty()) {
+			int k = deferred.back();
+			deferred.pop_back();
+			batch.drop();
+			if(waitLoaded(slots[k])) visit(k, buffers[slots[k]].data);
+			else failed = true;
+		}
+		if(!waited && !visited && next < pds.size()) throw NoBufferSpaceException();
+	}
+	if(failed) throw BufferManagerException("BufferManagerException : Read request failed");
+}
+
+BufferManager::ReadBatch::ReadBatch(BufferManager& _manager, const vector<PageDescriptor>& _pds) :
+	manager(_manager), pds(_pds), reader(_manager.acquireReader()), slots(_pds.size(), -1), held(0), spares(0) {}
+
+BufferManager::ReadBatch::~ReadBatch() {
+	int tag, result;
+	try {
+		while(reader -> wait(tag, result)) {
+			drop();
+			if(result == manager.pageSize) {
+				manager.finishLoad(slots[tag]);
+				manager.unpinPage(pds[tag]);
+			}
+			else manager.abandonLoad(slots[tag]);
+		}
+	}
+	catch(BufferManagerException& error) {
+		// the kernel may still write into the frames, they and the reader are given up
+		return;
+	}
+	for(int k : deferred) {
+		drop();
+		if(manager.waitLoaded(slots[k])) manager.unpinPage(pds[k]);
+	}
+	manager.releaseReader(reader);
+}
+
+// a pin for the next page, the first is free and the others come from asyncSpare
+bool BufferManager::ReadBatch::take() {
+	if(held > 0) {
+		if(manager.asyncSpare.fetch_sub(1) <= 0) {
+			manager.asyncSpare += 1;
+			return false;
+		}
+		spares += 1;
+	}
+	held += 1;
+	return true;
+}
+
+// a pin was handed to visit or dropped because its page could not be read
+void BufferManager::ReadBatch::drop() {
+	held -= 1;
+	if(spares > 0) {
+		spares -= 1;
+		manager.asyncSpare += 1;
+	}
+}
+
+// a reader of the pool, a new one when all are in use
+AsyncReader* BufferManager::acquireReader() {
+	{
+		lock_guard<mutex> guard(readerLock);
+		if(!readers.empty()) {
+			AsyncReader* reader = readers.back();
+			readers.pop_back();
+			return reader;
+		}
+	}
+	return new AsyncReader(asyncBackend, ASYNC_QUEUE_DEPTH);
+}
+
+void BufferManager::releaseReader(AsyncReader* reader) {
+	lock_guard<mutex> guard(readerLock);
+	readers.push_back(reader);
+}
+
+// the page of a frame claimed by the caller is in, wake the others waiting for it
+void BufferManager::finishLoad(int slot) {
+	buffers[slot].loaded = true;
+	{
+		lock_guard<mutex> guard(loadLock);
+		buffers[slot].loading = false;
+	}
+	loadDone.notify_all();
+}
+
+// wait until the pinned frame has been read in by the thread loading it
+char* BufferManager::pinLoaded(int slot) {
+	if(!waitLoaded(slot)) throw BufferManagerException("BufferManagerException : Read request failed");
+	return buffers[slot].data;
+}
+
+// false, and the pin dropped, when the read of the thread loading the frame failed
+bool BufferManager::waitLoaded(int slot) {
+	if(!buffers[slot].loaded) {
+		unique_lock<mutex> guard(loadLock);
+		loadDone.wait(guard, [this, slot]() { return !buffers[slot].loading; });
+		if(!buffers[slot].loaded) {
+			dropFailed(slot);
+			return false;
+		}
+	}
+	return true;
+}
+
+// take a frame whose read failed out of the buffer, the loading thread holds a pin
+void BufferManager::abandonLoad(int slot) {
+	{
+		lock_guard<mutex> replacer(replacerLock);
+		PageDescriptor pd = buffers[slot].pageDescriptor;
+		lock_guard<mutex> guard(shardOf(pd).lock);
+		shardOf(pd).table.erase(pd);
+		detach(slot);
+		buffers[slot].pageDescriptor = PageDescriptor();
+	}
+	{
+		lock_guard<mutex> guard(loadLock);
+		buffers[slot].loading = false;
+	}
+	loadDone.notify_all();
+	dropFailed(slot);
+}
+
+/*
+read up to count pages from pd on with one preadv, into frames of their own,
+and leave them unpinned in the buffer. it stops before the first page that
+is already there or when no frame is free. a scan calls it once for every
+window of pages it enters, see FileHandler::nextPage
+*/
+void BufferManager::prefetch(PageDescriptor pd, int count) {
+	count = min(count, max(1, numPages / 4));
+	if(count < 2 || lookup(pd) != -1) return;
+	vector<int> slots;
+	for(int k = 0; k < count; k++) {
+		// the pages claimed so far are pinned, so their frames are not chosen again
+		int slot;
+		int state = claimFrame(PageDescriptor(pd.fd, pd.pagenum + k), slot);
+		if(state == 0) buffers[slot].pinCount -= 1; // already there, not counted as a use
+		if(state != 1) break;
+		slots.push_back(slot);
+	}
+	if(slots.empty()) return;
+	vector<iovec> parts(slots.size());
+	for(int k = 0; k < slots.size(); k++) {
+		parts[k].iov_base = buffers[slots[k]].data;
+		parts[k].iov_len = pageSize;
+	}
+	long offset = pd.pagenum * (long)pageSize + FILE_HDR_SIZE;
+	long count_read = preadv(pd.fd, &parts[0], parts.size(), offset);
+	// a short read leaves the pages past its end to be read again on demand
+	int loaded = max(0L, count_read) / pageSize;
+	for(int k = 0; k < slots.size(); k++) {
+		if(k < loaded) {
+			finishLoad(slots[k]);
+			unpinPage(PageDescriptor(pd.fd, pd.pagenum + k));
+		}
+		else abandonLoad(slots[k]);
+	}
+}
+
+// a pin on a frame whose read failed, the last pin puts the frame onto the free list
+void BufferManager::dropFailed(int slot) {
+	if(buffers[slot].pinCount.fetch_sub(1) == 1) {
+		lock_guard<mutex> replacer(replacerLock);
+		freeList.push_front(slot);
 	}
 }
 
@@ -124,172 +552,459 @@ char* BufferManager::getPage(PageDescriptor pd) {
 //since new page, no contents in file
 //rest same as GetPage
 char* BufferManager::allocatePage(PageDescriptor pd) {
-	auto slot = hashTable.find(pd);
-	if(slot!=hashTable.end()) {
+	lock_guard<mutex> replacer(replacerLock);
+	// find a suitable slot to load it
+	int slotNo = findSlot();
+	if (slotNo==-1) throw NoBufferSpaceException(); //error no free slot could be obtained 
+	HashShard& shard = shardOf(pd);
+	lock_guard<mutex> guard(shard.lock);
+	if(shard.table.find(pd) != shard.table.end()) {
 		// error page already in buffers
+		freeList.push_front(slotNo);
 		throw BufferManagerException("BufferManagerException : Page to be allocated already in buffer");
 	}
-	else {
-		// page not in buffers
-		// find a suitable slot to load it
-		int slotNo = findSlot();
-		if (slotNo==-1) throw NoBufferSpaceException(); //error no free slot could be obtained 
-		// insert into hashTable the corresponding slot
-		hashTable.insert(make_pair(pd,slotNo));
-		// initialize the rest of Frame elements
-		initializeBuffer(pd,slotNo);
-		return buffers[slotNo].data;
-	}
+	// insert into hashTable the corresponding slot
+	shard.table.insert(make_pair(pd,slotNo));
+	// initialize the rest of Frame elements
+	initializeBuffer(pd,slotNo);
+	buffers[slotNo].loaded = true;
+	return buffers[slotNo].data;
 }
 
 // mark the page in buffer as dirty
 bool BufferManager::markDirty(PageDescriptor pd) {
-	auto slot = hashTable.find(pd);
-	if(slot==hashTable.end()) {
+	HashShard& shard = shardOf(pd);
+	// as in unpinPage the use is recorded while the page is seen pinned
+	unique_lock<mutex> replacer(replacerLock, defer_lock);
+	if(policy != CLOCK_POLICY) replacer.lock();
+	lock_guard<mutex> guard(shard.lock);
+	auto slot = shard.table.find(pd);
+	if(slot==shard.table.end()) {
 		//error page not in buffers
 		return false;
 	}
 	int slotNo = slot->second;
-	if(!buffers[slotNo].pinned) {
+	if(buffers[slotNo].pinCount == 0) {
 		//error page unpinned
 		return false;
 	}
 	// set page dirty
 	buffers[slotNo].dirty=true;
 	//make this page MRU in buffers
-	LRUList.remove(slotNo); 
-	LRUList.push_front(slotNo); // put at front	
+	touch(slotNo, false);
 	return true;
 }
 
 // unpin page -- required so that buffer manager can free up space from such marked buffers
 
 bool BufferManager::unpinPage(PageDescriptor pd) {
-	auto slot = hashTable.find(pd); //find slot 
-	if(slot==hashTable.end()) {
+	HashShard& shard = shardOf(pd);
+	// the use is recorded before the pin is dropped, after that the frame may
+	// be released and given to another page
+	unique_lock<mutex> replacer(replacerLock, defer_lock);
+	if(policy != CLOCK_POLICY) replacer.lock();
+	lock_guard<mutex> guard(shard.lock); //find slot 
+	auto slot = shard.table.find(pd);
+	if(slot==shard.table.end()) {
 		//error page not in buffers
 		return false;
 	}
 	int slotNo = slot->second;
-	if(!buffers[slotNo].pinned) {
+	if(buffers[slotNo].pinCount == 0) {
 		//error page unpinned
 		return false;
 	}
-	buffers[slotNo].pinned = false; //set unpinned
 	// set page as MRU
-	LRUList.remove(slotNo); 
-	LRUList.push_front(slotNo); // put at front
+	touch(slotNo, false);
+	buffers[slotNo].pinCount -= 1; //drop one pin
 	return true;	
 }
 
-// release all pages for file and put them onto free list
+/*
+latch a page pinned by the caller, shared to read its bytes, exclusive to
+change them. false when the page is not in the buffer or not pinned
+*/
+bool BufferManager::latchPage(PageDescriptor pd, bool exclusive) {
+	int slot = lookup(pd);
+	if(slot == -1 || buffers[slot].pinCount == 0) return false;
+	if(exclusive) buffers[slot].latch.lock();
+	else buffers[slot].latch.lock_shared();
+	return true;
+}
+
+bool BufferManager::unlatchPage(PageDescriptor pd, bool exclusive) {
+	int slot = lookup(pd);
+	if(slot == -1) return false;
+	if(exclusive) buffers[slot].latch.unlock();
+	else buffers[slot].latch.unlock_shared();
+	return true;
+}
+
+// the frames holding pages of file, in order of page number, with the replacement lock held
+vector<int> BufferManager::framesOf(int fd) {
+	vector<pair<int, int>> pages;
+	// one pass over the frames, free frames have fd -1
+	for(int i = 0; i < numPages; i++) {
+		if(buffers[i].pageDescriptor.fd == fd) pages.push_back(make_pair(buffers[i].pageDescriptor.pagenum, i));
+	}
+	sort(pages.begin(), pages.end());
+	vector<int> slots;
+	for(auto& page : pages) slots.push_back(page.second);
+	return slots;
+}
+
+// write back all pages for file and put the unpinned ones onto free list
 bool BufferManager::flushPages(int fd) {
-	// do a linear scan for all pages belonging to this file
-	for(int i=0;i<numPages;i++) {
-		if(find(LRUList.begin(),LRUList.end(),i)==LRUList.end()) continue; // skip free slots
-		if(buffers[i].pageDescriptor.fd != fd) continue;
-		//write back page if dirty
-		if(buffers[i].dirty) {
-			bool _res = writePage(PageDescriptor(fd,buffers[i].pageDescriptor.pagenum),buffers[i].data);
-			if(!_res) return false;
-			buffers[i].dirty = false;
-		}
-		//remove slot from hashTable and LRUList and add to free list
-		hashTable.erase(PageDescriptor(fd,buffers[i].pageDescriptor.pagenum));
-		LRUList.remove(i);
-		freeList.push_front(i);
+	lock_guard<mutex> replacer(replacerLock);
+	vector<int> slots = framesOf(fd);
+	//write back the dirty pages
+	if(!writeBackPages(slots)) return false;
+	for(int i : slots) {
+		lock_guard<mutex> guard(shardOf(buffers[i].pageDescriptor).lock);
+		//remove slot from hashTable and its queue and add to free list
+		if(buffers[i].pinCount == 0 && !buffers[i].dirty) release(i);
 	}
 	return true;
 }
 
-// release given page of file from buffers
-bool BufferManager::flushPage(PageDescriptor pd) {
-	// do a linear scan to find the corresponding page 
-	for(int i=0;i<numPages;i++) {
-		if(find(LRUList.begin(),LRUList.end(),i)==LRUList.end()) continue; // skip free slots
-		if(!(buffers[i].pageDescriptor== pd)) continue;
-		//write back page if dirty
-		if(buffers[i].dirty) {
-			bool _res = writePage(pd,buffers[i].data);
-			if(!_res) return false;
-			buffers[i].dirty = false;
-		}
-		//remove slot from hashTable and LRUList and add to free list
-		hashTable.erase(pd);
-		LRUList.remove(i);
-		freeList.push_front(i);
-		break; // only once instance 
+/*
+write back the dirty pages of file in order of page number and keep them in
+the buffer. with sync the file is synced once at the end, so the pages
+written are on disk when it returns
+*/
+bool BufferManager::checkpoint(int fd, bool sync) {
+	{
+		lock_guard<mutex> replacer(replacerLock);
+		if(!writeBackPages(framesOf(fd))) return false;
 	}
+	if(sync && fdatasync(fd) < 0) return false;
+	return true;
+}
+
+// write back given page of file and release it from buffers unless it is pinned
+bool BufferManager::flushPage(PageDescriptor pd) {
+	lock_guard<mutex> replacer(replacerLock);
+	HashShard& shard = shardOf(pd);
+	lock_guard<mutex> guard(shard.lock);
+	auto slot = shard.table.find(pd);
+	if(slot == shard.table.end()) return true; // page not in buffers
+	int i = slot -> second;
+	//write back page if dirty
+	if(!writeBack(i)) return false;
+	//remove slot from hashTable and its queue and add to free list
+	if(buffers[i].pinCount == 0) release(i);
 	return true;
 }
 
 void BufferManager::printBuffer() {
+	lock_guard<mutex> replacer(replacerLock);
 	cout << "Buffer contains " << numPages << " pages of size "
       << pageSize <<".\n";
-   cout << "Contents in order from most recently used to "
-      << "least recently used.\n";
+	vector<int> order;
+	if(policy == LRU_POLICY || policy == TWO_Q_POLICY) {
+		cout << "Contents in order from most recently used to "
+		  << "least recently used" << (policy == TWO_Q_POLICY ? ", frequent pages first.\n" : ".\n");
+		for(int slot = recent.head; slot != -1; slot = buffers[slot].next) order.push_back(slot);
+		for(int slot = incoming.head; slot != -1; slot = buffers[slot].next) order.push_back(slot);
+	}
+	else if(policy == LRU_K_POLICY) {
+		cout << "Contents in order of eviction.\n";
+		for(auto& entry : history) order.push_back(entry.second);
+	}
+	else {
+		cout << "Contents in order of frames.\n";
+		for(int i = 0; i < numPages; i++) if(buffers[i].pageDescriptor.fd != -1) order.push_back(i);
+	}
 
-    for(auto slot:LRUList) {
+    for(auto slot:order) {
     	cout << slot << " :: \n";
       	cout << "  fd = " << buffers[slot].pageDescriptor.fd << "\n";
       	cout << "  pageNum = " << buffers[slot].pageDescriptor.pagenum << "\n";
       	cout << "  Dirty = " << buffers[slot].dirty << "\n";
-      	cout << "  pinned = " << buffers[slot].pinned << "\n";
+      	cout << "  pinCount = " << buffers[slot].pinCount << "\n";
       
     }
 }
 
+// drop every unpinned page, changes are not written back
 void BufferManager::clearBuffer() {
-	while(!LRUList.empty()) {
-		int slot = LRUList.front();
-		LRUList.pop_front(); // remove front LRUList
-		hashTable.erase(buffers[slot].pageDescriptor); //remove from hash table
-		freeList.push_front(slot); // add to free list
+	lock_guard<mutex> replacer(replacerLock);
+	for(int i = 0; i < numPages; i++) {
+		if(buffers[i].pageDescriptor.fd == -1) continue;
+		lock_guard<mutex> guard(shardOf(buffers[i].pageDescriptor).lock);
+		if(buffers[i].pinCount == 0) release(i); // remove from hash table and queue, add to free list
 	}
+	ghosts.clear();
+	ghostTable.clear();
 }
 
 //FindSlot - find a free slot , if no free, then find a victim slot from unpinned pages 
-// return -1 if replacement not possible
+// return -1 if replacement not possible. called with the replacement lock held
 int BufferManager::findSlot() {
 	// if free slot available
 	if(!freeList.empty()) {
 		int slot = freeList.front();
 		freeList.pop_front();
-		LRUList.push_front(slot);
 		return slot;
 	}
-	else {
-		// since used list has MRU in front 
-		// start search for a unpinned page from last 
-		for(auto slot = LRUList.rbegin();slot!=LRUList.rend();slot++) {
-			if(!buffers[*slot].pinned) {
-				// page will be replaced
-				// if dirty write to the file
-				if(buffers[*slot].dirty) {
-					int _res = writePage(buffers[*slot].pageDescriptor,buffers[*slot].data);
-					if(_res<0) continue;
-					buffers[*slot].dirty=false;
+	return pickVictim(); // -1 when no slot available
+}
+
+// a frame evicted by the policy, -1 when every frame is pinned
+int BufferManager::pickVictim() {
+	if(policy == CLOCK_POLICY) {
+		// a referenced frame gets a second chance, so two rounds reach every unpinned frame
+		for(int step = 0; step < 2 * numPages; step++) {
+			int slot = hand;
+			hand = (hand + 1) % numPages;
+			if(buffers[slot].pinCount > 0 || buffers[slot].pageDescriptor.fd == -1) continue;
+			if(buffers[slot].referenced.exchange(false)) continue;
+			if(evict(slot)) return slot;
+		}
+		return -1;
+	}
+	if(policy == LRU_K_POLICY) {
+		for(auto entry = history.begin(); entry != history.end(); ++entry) {
+			int slot = entry -> second;
+			if(evict(slot)) return slot;
+		}
+		return -1;
+	}
+	if(policy == TWO_Q_POLICY) {
+		// the FIFO queue keeps a quarter of the frames
+		int slot = -1;
+		if(incoming.size > max(1, numPages / 4)) slot = victimFrom(incoming);
+		if(slot == -1) slot = victimFrom(recent);
+		if(slot == -1) slot = victimFrom(incoming);
+		return slot;
+	}
+	return victimFrom(recent);
+}
+
+// the least recently used frame of queue that can be evicted, evicted
+int BufferManager::victimFrom(FrameQueue& queue) {
+	for(int slot = queue.tail; slot != -1; slot = buffers[slot].prev) {
+		if(evict(slot)) return slot;
+	}
+	return -1;
+}
+
+/*
+evict an unpinned frame once its page is written back, it leaves the page
+table and the policy. pins are taken under the shard lock, so the pin count
+seen here cannot change before the frame is gone
+*/
+bool BufferManager::evict(int slot) {
+	if(buffers[slot].pinCount > 0) return false;
+	PageDescriptor pd = buffers[slot].pageDescriptor;
+	HashShard& shard = shardOf(pd);
+	lock_guard<mutex> guard(shard.lock);
+	if(buffers[slot].pinCount > 0) return false;
+	// if dirty write to the file
+	if(!writeBack(slot)) return false;
+	// 2Q remembers the pages leaving the FIFO queue in ghosts
+	if(policy == TWO_Q_POLICY && buffers[slot].queue == 1) {
+		ghosts.push_front(pd);
+		ghostTable[pd] = ghosts.begin();
+		if((int)ghosts.size() > max(1, numPages / 2)) {
+			ghostTable.erase(ghosts.back());
+			ghosts.pop_back();
+		}
+	}
+	detach(slot);
+	shard.table.erase(pd);
+	buffers[slot].pageDescriptor = PageDescriptor();
+	return true;
+}
+
+/*
+write the page of a frame to the file if it is dirty, with the shard lock
+held. a page latched exclusively is being changed and is left dirty, its
+user holds a pin, so evict and flushPage keep the frame
+*/
+bool BufferManager::writeBack(int slot) {
+	if(!buffers[slot].dirty) return true;
+	if(!buffers[slot].latch.try_lock_shared()) {
+		assert(buffers[slot].pinCount > 0);
+		return true;
+	}
+	bool _res = writePage(buffers[slot].pageDescriptor, buffers[slot].data);
+	buffers[slot].latch.unlock_shared();
+	if(!_res) return false;
+	buffers[slot].dirty = false;
+	return true;
+}
+
+/*
+write back the dirty pages of slots, given in order of page number, with the
+replacement lock held. adjacent pages go out together in one pwritev of at
+most IO_BATCH_PAGES pages. as in writeBack a page latched exclusively is
+left dirty
+*/
+bool BufferManager::writeBackPages(const vector<int>& slots) {
+	vector<int> run;
+	for(int i : slots) {
+		{
+			lock_guard<mutex> guard(shardOf(buffers[i].pageDescriptor).lock);
+			if(!buffers[i].dirty) continue;
+			if(!buffers[i].latch.try_lock_shared()) {
+				assert(buffers[i].pinCount > 0);
+				continue;
+			}
+		}
+		if(!run.empty()) {
+			int last = buffers[run.back()].pageDescriptor.pagenum;
+			if(buffers[i].pageDescriptor.pagenum != last + 1 || run.size() == IO_BATCH_PAGES) {
+				if(!writeRun(run)) {
+					buffers[i].latch.unlock_shared();
+					return false;
 				}
-				//remove from hash table , and LRUList
-				hashTable.erase(buffers[*slot].pageDescriptor);
-				// move the slot to MRU (front of used list)
-				int slot_val = *slot;
-				LRUList.remove(slot_val);
-				LRUList.push_front(slot_val);
-				return slot_val;
 			}
 		}
+		run.push_back(i);
+	}
+	return writeRun(run);
+}
+
+/*
+write a run of frames holding adjacent pages with one call, the frames are
+latched shared by the caller and unlatched here. a frame is clean again
+before its latch is dropped, so a change made after the write marks it
+dirty anew
+*/
+bool BufferManager::writeRun(vector<int>& run) {
+	if(run.empty()) return true;
+	vector<iovec> parts(run.size());
+	for(int k = 0; k < run.size(); k++) {
+		parts[k].iov_base = buffers[run[k]].data;
+		parts[k].iov_len = pageSize;
+	}
+	long offset = buffers[run[0]].pageDescriptor.pagenum * (long)pageSize + FILE_HDR_SIZE;
+	bool _res = pwritev(buffers[run[0]].pageDescriptor.fd, &parts[0], parts.size(), offset) == (long)run.size() * pageSize;
+	for(int i : run) {
+		if(_res) {
+			lock_guard<mutex> guard(shardOf(buffers[i].pageDescriptor).lock);
+			buffers[i].dirty = false;
+		}
+		buffers[i].latch.unlock_shared();
+	}
+	run.clear();
+	return _res;
+}
+
+// enter a frame just loaded into the policy
+void BufferManager::admit(int slot) {
+	if(policy == CLOCK_POLICY) {
+		buffers[slot].referenced = true;
+	}
+	else if(policy == LRU_K_POLICY) {
+		buffers[slot].prevUse = 0;
+		buffers[slot].lastUse = ++useCount;
+		history.insert(make_pair(make_pair(buffers[slot].prevUse, buffers[slot].lastUse), slot));
+	}
+	else if(policy == TWO_Q_POLICY) {
+		// a page seen again soon after it left the FIFO queue is frequent
+		auto ghost = ghostTable.find(buffers[slot].pageDescriptor);
+		if(ghost != ghostTable.end()) {
+			ghosts.erase(ghost -> second);
+			ghostTable.erase(ghost);
+			pushFront(recent, 0, slot);
+		}
+		else pushFront(incoming, 1, slot);
+	}
+	else {
+		pushFront(recent, 0, slot);
 	}
-	return -1; // no slot available
+}
+
+/*
+record a use of a frame pinned by the caller, CLOCK only sets the reference
+bit and takes no lock. the pin keeps the frame from being given to another
+page, it only leaves the buffer when its read failed
+*/
+void BufferManager::reference(int slot, bool request) {
+	if(policy == CLOCK_POLICY) {
+		buffers[slot].referenced = true;
+		return;
+	}
+	lock_guard<mutex> replacer(replacerLock);
+	touch(slot, request);
+}
+
+/*
+a use of a frame in the buffer. reference is true for a new request of the
+page, false for markDirty / unpinPage within the same request, which LRU-K
+and 2Q do not count as another reference
+*/
+void BufferManager::touch(int slot, bool reference) {
+	// a frame whose read failed is on its way to the free list
+	if(buffers[slot].pageDescriptor.fd == -1) return;
+	if(policy == CLOCK_POLICY) {
+		buffers[slot].referenced = true;
+	}
+	else if(policy == LRU_K_POLICY) {
+		if(!reference) return;
+		history.erase(make_pair(make_pair(buffers[slot].prevUse, buffers[slot].lastUse), slot));
+		buffers[slot].prevUse = buffers[slot].lastUse;
+		buffers[slot].lastUse = ++useCount;
+		history.insert(make_pair(make_pair(buffers[slot].prevUse, buffers[slot].lastUse), slot));
+	}
+	else if(policy == TWO_Q_POLICY) {
+		// pages of the FIFO queue keep their place
+		if(buffers[slot].queue == 0) pushFront(recent, 0, slot);
+	}
+	else {
+		pushFront(recent, 0, slot);
+	}
+}
+
+// take a frame out of the policy
+void BufferManager::detach(int slot) {
+	if(policy == LRU_K_POLICY) {
+		history.erase(make_pair(make_pair(buffers[slot].prevUse, buffers[slot].lastUse), slot));
+	}
+	unlink(slot);
+	buffers[slot].referenced = false;
+}
+
+// drop a frame from the buffer and put it onto the free list, with the replacement and shard locks held
+void BufferManager::release(int slot) {
+	detach(slot);
+	shardOf(buffers[slot].pageDescriptor).table.erase(buffers[slot].pageDescriptor);
+	buffers[slot].pageDescriptor = PageDescriptor();
+	freeList.push_front(slot);
+}
+
+// move slot to the front of queue, in O(1)
+void BufferManager::pushFront(FrameQueue& queue, int queueId, int slot) {
+	unlink(slot);
+	buffers[slot].prev = -1;
+	buffers[slot].next = queue.head;
+	if(queue.head != -1) buffers[queue.head].prev = slot;
+	else queue.tail = slot;
+	queue.head = slot;
+	queue.size += 1;
+	buffers[slot].queue = queueId;
+}
+
+// remove slot from the queue holding it, if any
+void BufferManager::unlink(int slot) {
+	if(buffers[slot].queue == -1) return;
+	FrameQueue& queue = buffers[slot].queue == 0 ? recent : incoming;
+	if(buffers[slot].prev != -1) buffers[buffers[slot].prev].next = buffers[slot].next;
+	else queue.head = buffers[slot].next;
+	if(buffers[slot].next != -1) buffers[buffers[slot].next].prev = buffers[slot].prev;
+	else queue.tail = buffers[slot].prev;
+	queue.size -= 1;
+	buffers[slot].prev = buffers[slot].next = buffers[slot].queue = -1;
 }
 
 // read page from the file and return character array to it
 bool BufferManager::readPage(PageDescriptor pd, char *dest) {
 	// calculate file offset
 	long offset = pd.pagenum * (long)pageSize + FILE_HDR_SIZE;
-	lseek(pd.fd, offset, 0); // seek to location
 	int count = -1;
-	count = read(pd.fd, dest, pageSize);
+	count = pread(pd.fd, dest, pageSize, offset);
 	if(count != pageSize) //read failed
 		return false;
 	return true;
@@ -299,17 +1014,18 @@ bool BufferManager::readPage(PageDescriptor pd, char *dest) {
 bool BufferManager::writePage(PageDescriptor pd,char *src) {
 	// calculate file offset
 	long offset = pd.pagenum*(long)pageSize + FILE_HDR_SIZE;
-	lseek(pd.fd,offset,0); // seek to location
-	if(write(pd.fd,src,pageSize)!=pageSize) //write failed
+	if(pwrite(pd.fd,src,pageSize,offset)!=pageSize) //write failed
 		return false;
 	return true;
 }	
 
-// helper function to initialize buffer page after page read 
+// helper function to initialize a frame given to a page, pinned once by the caller
+// called with the replacement and shard locks held
 void BufferManager::initializeBuffer(PageDescriptor pd, int slot) {
 	buffers[slot].pageDescriptor = pd;
 	buffers[slot].dirty = false;
-	buffers[slot].pinned = true;
+	buffers[slot].pinCount = 1;
+	admit(slot);
 }
 
 #endif
\ No newline at end of file
@@ -11,6 +11,11 @@
 #include <cassert>
 
 const int BUFFER_SIZE = 40;
+const int HASH_SHARDS = 16; // parts of the buffer's page table, each with its own lock
+const int IO_BATCH_PAGES = 64; // most adjacent pages written by one pwritev
+const int READ_AHEAD_PAGES = 8; // pages of the window a scan reads with one preadv
+const int ASYNC_QUEUE_DEPTH = 32; // reads in flight at most for one getPages call
+const int ASYNC_THREADS = 4; // threads of an AsyncReader without io_uring
 const int PAGE_SIZE = 4096;
 const int PAGE_CONTENT_SIZE = PAGE_SIZE - sizeof(int);
 const int END_FREE = -1;
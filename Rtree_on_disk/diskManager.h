@@ -14,7 +14,7 @@
 
 class BufferManager;
 class StatsManager;
-extern int FileManagerInstanceCount;
+extern atomic<int> FileManagerInstanceCount;
 
 struct PageHdr {
     int nextFreePage;
@@ -76,17 +76,23 @@ public:
     PageHandler firstPage();
     PageHandler nextPage(int page_number);
     PageHandler pageAt(int page_number);
+    template <typename Visitor>
+    void pagesAt(const std::vector<int>& page_numbers, Visitor&& visit);
     PageHandler lastPage();
     PageHandler prevPage(int page_number);
     PageHandler newPage();
     bool disposePage(int pageNum);
     bool markDirty(int pageNum);
     bool unpinPage(int pageNum);
+    bool latchPage(int pageNum, bool exclusive = false);
+    bool unlatchPage(int pageNum, bool exclusive = false);
     bool flushPage(int page_number);
     bool flushPages();
+    bool checkpoint(bool sync = false);
 
 private:
     bool checkPageValid(int page_number);
+    bool writeHeader();
     BufferManager* bufferManager;
     FileHdr hdr;
     bool isOpen;
@@ -126,7 +132,13 @@ PageHandler FileHandler::nextPage(int page_number) {
 	}
 	// start searching for next valid(used) page 
 	page_number = page_number + 1;
-	for( ; page_number <= hdr.totalPages; page_number++) { // MR: page_number <= totalpages to ensure that it runs this at least once if file contains only one page
+	for( ; page_number < hdr.totalPages; page_number++) { // past the last page the handle keeps page number -1
+		// a scan reads a window of READ_AHEAD_PAGES pages with one call when it enters
+		// the window, pages of it already in the buffer are read on demand
+		if(page_number % READ_AHEAD_PAGES == 0) {
+			int ahead = std::min(READ_AHEAD_PAGES, hdr.totalPages - page_number);
+			bufferManager -> prefetch(PageDescriptor(this -> unix_file_desc, page_number), ahead);
+		}
 		pageHandle = pageAt(page_number);
 		if(pageHandle.getPageNum() != -1) break;
 	}
@@ -155,6 +167,30 @@ PageHandler FileHandler::pageAt(int page_number) {
 	return pageHandle;
 }
 
+/*
+pageAt for many pages at once: the pages not in the buffer are read
+together, and visit(PageHandler&) is called for each page as soon as it is
+there, in no particular order. visit unpins the page, a free page is
+handed over unpinned with page number -1
+*/
+template <typename Visitor>
+void FileHandler::pagesAt(const std::vector<int>& page_numbers, Visitor&& visit) {
+	std::vector<PageDescriptor> pages;
+	for(int page_number : page_numbers) {
+		if(!checkPageValid(page_number)) throw InvalidPageException();
+		pages.push_back(PageDescriptor(this -> unix_file_desc, page_number));
+	}
+	bufferManager -> getPages(pages, [this, &page_numbers, &visit](int k, char* page_in_buffer) {
+		PageHandler pageHandle;
+		if(((PageHdr*)page_in_buffer) -> nextFreePage == NOT_FREE) {
+			pageHandle.pageNum = page_numbers[k];
+			pageHandle.data = page_in_buffer + sizeof(PageHdr);
+		}
+		else unpinPage(page_numbers[k]);
+		visit(pageHandle);
+	});
+}
+
 PageHandler FileHandler::lastPage() {
 	// logic - use PrevPage with page number = total_pages == same as fetch first valid page from last (total_pages-1)
 	int total_pages = (this->hdr).totalPages;
@@ -248,27 +284,48 @@ bool FileHandler::unpinPage(int page_number) {
 	return bufferManager -> unpinPage(pp);
 }
 
+// latch a pinned page, shared while its data is read, exclusive while it is changed
+// pages may be read by many threads at once, newPage and disposePage are for one thread at a time
+bool FileHandler::latchPage(int page_number, bool exclusive) {
+	auto pp = PageDescriptor(this -> unix_file_desc, page_number);
+	return bufferManager -> latchPage(pp, exclusive);
+}
+
+bool FileHandler::unlatchPage(int page_number, bool exclusive) {
+	auto pp = PageDescriptor(this -> unix_file_desc, page_number);
+	return bufferManager -> unlatchPage(pp, exclusive);
+}
+
 // flush all pages to file
 // note if header is changed, we need to write it back here
 // since buffer manager would only deal with pages
 bool FileHandler::flushPages() {
-	if(this -> hdrChanged) {
-		lseek(this -> unix_file_desc, 0, 0); // seek file pointer to start
-		int _wr_res = write(this -> unix_file_desc, (char*)&hdr, sizeof(FileHdr));
-		if(_wr_res < 0) return false; //write error
-		this -> hdrChanged = false;
-	}
+	if(!writeHeader()) return false;
 	return bufferManager -> flushPages(this -> unix_file_desc);
 }
 
+/*
+write the header and every dirty page of the file back, pages stay in the
+buffer. with sync the data is on disk when it returns, one fdatasync for
+the whole checkpoint
+*/
+bool FileHandler::checkpoint(bool sync) {
+	if(!writeHeader()) return false;
+	return bufferManager -> checkpoint(this -> unix_file_desc, sync);
+}
+
+// write the file header back if it changed
+bool FileHandler::writeHeader() {
+	if(!this -> hdrChanged) return true;
+	int _wr_res = pwrite(this -> unix_file_desc, (char*)&hdr, sizeof(FileHdr), 0);
+	if(_wr_res < 0) return false; //write error
+	this -> hdrChanged = false;
+	return true;
+}
+
 // flush individual page out of buffer manager
 bool FileHandler::flushPage(int page_number) {
-	if(this -> hdrChanged) {
-		lseek(this -> unix_file_desc, 0, 0); // seek file pointer to start
-		int _wr_res = write(this -> unix_file_desc, (char *)&hdr, sizeof(FileHdr));
-		if(_wr_res < 0) return false; //write error
-		this -> hdrChanged = false;
-	}
+	if(!writeHeader()) return false;
 	auto pp = PageDescriptor(this -> unix_file_desc,page_number);
 	return bufferManager -> flushPage(pp);
 }
@@ -280,7 +337,7 @@ bool FileHandler::checkPageValid(int page_number) {
 
 class FileManager {
 public:
-    FileManager();
+    FileManager(int numPages = BUFFER_SIZE, int policy = LRU_POLICY, int asyncBackend = URING_BACKEND);
     ~FileManager();
     FileHandler createFile(const char* fileName);
     FileHandler openFile(const char* fileName);
@@ -293,16 +350,19 @@ private:
     BufferManager* bufferManager;
 };
 
-int FileManagerInstanceCount = 0;
+atomic<int> FileManagerInstanceCount(0);
 
-FileManager::FileManager() {
+// a buffer of numPages frames, policy is its replacement policy (see bufferManager.h)
+// and asyncBackend the way it reads many pages at once (see asyncIO.h)
+FileManager::FileManager(int numPages, int policy, int asyncBackend) {
 	// intialize manager with a buffer manager
 	// thus buffer manager will be hidden from student API access 
-	if(FileManagerInstanceCount==1) {
+	// only one instance at a time, also when two threads construct one at once
+	int expected = 0;
+	if(!FileManagerInstanceCount.compare_exchange_strong(expected, 1)) {
 		throw FileManagerInstanceException();
 	}
-	FileManagerInstanceCount = 1;
-	bufferManager = new BufferManager(BUFFER_SIZE);
+	bufferManager = new BufferManager(numPages, policy, asyncBackend);
 }
 
 FileManager::~FileManager() {
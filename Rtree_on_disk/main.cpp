@@ -20,7 +20,7 @@ int main(){
   out.open("./data/TC_1/answer.txt");
   int maxCap = 10;
   int dimensionality = 2;
-  RTree rt = RTree(maxCap,fh);
+  RTree rt = RTree(maxCap,fh,WRITE_BACK);
   std::string line;
   while(inp >> line){
     if( line == "INSERT"){